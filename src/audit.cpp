@@ -0,0 +1,192 @@
+#include "audit.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "crc32.h"
+#include "threadPool.h"
+#include "zipEntry.h"
+
+using namespace std;
+
+struct Finding
+{
+    Node* node;
+    string text;
+};
+
+// Everything a worker needs, read from the tree up front: the tree's accessors are not safe to share between threads
+struct AuditJob
+{
+    const ZipEntry* entry;
+    uint32_t expectedCrc;
+    uint64_t expectedSize;
+    Node* crcNode;
+    Node* sizeNode;
+
+    bool verified;
+    uint64_t bytesChecked;
+    vector<Finding> findings;
+};
+
+static string formatField(uint64_t value, bool asHex)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), asHex ? "0x%08" PRIX64 : "%" PRIu64, value);
+    return buffer;
+}
+
+// Compares the local file header against the central directory file header that points at it
+static void crossCheck(const ZipEntry& entry, vector<Finding>& findings)
+{
+    if (entry.localHeader == NULL)
+    {
+        findings.push_back({entry.centralHeader, "no matching local file header"});
+        return;
+    }
+
+    struct FieldPair
+    {
+        const char* localDescription;
+        const char* centralDescription;
+        bool asHex;
+        bool inDataDescriptor;  // Zero in the local header when the data descriptor flag is set
+    };
+    static const FieldPair fieldPairs[] = {
+        {"Version", "Version needed", false, false},
+        {"Flags", "Flags", true, false},
+        {"Compression method", "Compression method", false, false},
+        {"File modification time", "File modification time", true, false},
+        {"File modification date", "File modification date", true, false},
+        {"CRC-32 checksum", "CRC-32 checksum", true, true},
+        {"Compressed size", "Compressed size", false, true},
+        {"Uncompressed size", "Uncompressed size", false, true}
+    };
+
+    bool hasDataDescriptor = (readNodeUInt(findChild(entry.localHeader, "Flags")) & ZipEntry::FLAG_DATA_DESCRIPTOR) != 0;
+    for (unsigned int pairIdx = 0; pairIdx < sizeof(fieldPairs) / sizeof(fieldPairs[0]); pairIdx++)
+    {
+        const FieldPair& pair = fieldPairs[pairIdx];
+        if (pair.inDataDescriptor && hasDataDescriptor)
+        { continue; }
+
+        Node* localNode = findChild(entry.localHeader, pair.localDescription);
+        Node* centralNode = findChild(entry.centralHeader, pair.centralDescription);
+        uint64_t localValue = readNodeUInt(localNode);
+        if (localValue != readNodeUInt(centralNode))
+        {
+            findings.push_back({centralNode, "local header has " + formatField(localValue, pair.asHex)});
+        }
+    }
+
+    Node* centralName = findChild(entry.centralHeader, "File name");
+    if (readNodeText(centralName) != entry.name)
+    {
+        findings.push_back({centralName, "local header has \"" + entry.name + "\""});
+    }
+}
+
+// Runs on a worker thread. Touches only the job and the file descriptor.
+static void verifyData(int fd, AuditJob& job)
+{
+    const ZipEntry& entry = *job.entry;
+    if (entry.localHeader == NULL || ! entry.canDecompress())
+    { return; }
+
+    uint32_t crc = 0;
+    uint64_t size = 0;
+    bool ok = readEntryData(fd, entry, [&crc, &size](const byte* buffer, long len) {
+        crc = crc32Update(crc, buffer, len);
+        size += len;
+        return true;
+    });
+
+    job.verified = true;
+    job.bytesChecked = size;
+
+    if (! ok)
+    {
+        job.findings.push_back({(entry.fileData != NULL) ? entry.fileData : entry.localHeader, "corrupt or truncated data"});
+        return;
+    }
+
+    if (crc != job.expectedCrc)
+    {
+        job.findings.push_back({job.crcNode, "data has CRC-32 " + formatField(crc, true)});
+    }
+    if (size != job.expectedSize)
+    {
+        job.findings.push_back({job.sizeNode, "data is " + formatField(size, false) + " bytes"});
+    }
+}
+
+long auditArchive(FILE *fp, Node *root, int threadCnt, AuditStats *stats)
+{
+    vector<ZipEntry> entries = findZipEntries(root);
+    vector<AuditJob> jobs(entries.size());
+
+    set<Node*> listedLocalHeaders;
+    for (unsigned int entryIdx = 0; entryIdx < entries.size(); entryIdx++)
+    {
+        const ZipEntry& entry = entries[entryIdx];
+        AuditJob& job = jobs[entryIdx];
+        job.entry = &entry;
+        job.verified = false;
+        job.bytesChecked = 0;
+
+        // The local header may hold zeros, leaving the values to a data descriptor; the central directory has them
+        job.crcNode = findChild(entry.centralHeader, "CRC-32 checksum");
+        job.sizeNode = findChild(entry.centralHeader, "Uncompressed size");
+        job.expectedCrc = entry.crc32;
+        job.expectedSize = entry.uncompressedSize;
+
+        crossCheck(entry, job.findings);
+
+        if (entry.localHeader != NULL)
+        { listedLocalHeaders.insert(entry.localHeader); }
+    }
+
+    int fd = fileno(fp);
+    ThreadPool pool(threadCnt);
+    for (vector<AuditJob>::iterator iter = jobs.begin(); iter < jobs.end(); iter++)
+    {
+        AuditJob* job = &(*iter);
+        pool.submit([fd, job]() { verifyData(fd, *job); });
+    }
+    pool.wait();
+
+    long problemCnt = 0;
+    long verifiedCnt = 0;
+    uint64_t bytesChecked = 0;
+    for (vector<AuditJob>::iterator iter = jobs.begin(); iter < jobs.end(); iter++)
+    {
+        for (vector<Finding>::iterator finding = iter->findings.begin(); finding < iter->findings.end(); finding++)
+        {
+            annotateNode(finding->node, finding->text.c_str());
+            problemCnt++;
+        }
+        verifiedCnt += iter->verified ? 1 : 0;
+        bytesChecked += iter->bytesChecked;
+    }
+
+    vector<Node*> localHeaders = findLocalHeaders(root);
+    for (vector<Node*>::iterator iter = localHeaders.begin(); iter < localHeaders.end(); iter++)
+    {
+        if (listedLocalHeaders.count(*iter) == 0)
+        {
+            annotateNode(*iter, "not listed in the central directory");
+            problemCnt++;
+        }
+    }
+
+    if (stats != NULL)
+    {
+        stats->entryCnt = entries.size();
+        stats->verifiedCnt = verifiedCnt;
+        stats->problemCnt = problemCnt;
+        stats->bytesChecked = bytesChecked;
+    }
+
+    return problemCnt;
+}
@@ -0,0 +1,27 @@
+#ifndef BINVIEW_AUDIT
+#define BINVIEW_AUDIT
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "hierarchy.h"
+
+struct AuditStats
+{
+    long entryCnt;
+    long verifiedCnt;   // Entries whose data was checksummed (others use unsupported compression)
+    long problemCnt;    // Annotations added
+    uint64_t bytesChecked;
+};
+
+/*
+ * Checks the integrity of a parsed zip archive:
+ *  - the CRC-32 and size of each entry's uncompressed data against its headers, and
+ *  - each local file header against its central directory file header.
+ * Entries are checksummed concurrently on threadCnt workers (0 means one per core).
+ * Every problem found is attached to the offending node with annotateNode().
+ * Returns the number of problems found.
+ */
+long auditArchive(FILE *fp, Node *root, int threadCnt, AuditStats *stats = NULL);
+
+#endif
@@ -1,5 +1,7 @@
 #include "byteAccessor.h"
 
+#include <fcntl.h>
+
 MemoryAccessor::MemoryAccessor(byte* src, long len) : src(src), len(len) {}
 
 byte MemoryAccessor::operator[](long idx)
@@ -99,6 +101,16 @@ IByteIterator* AggAccessor::iterator()
     return out;
 }
 
+void AggAccessor::prefetch(long length)
+{
+    for (int srcIdx = 0; srcIdx < len && length != 0; srcIdx++)
+    {
+        src[srcIdx]->prefetch(length);
+        if (length != -1)
+        { length -= (length < src[srcIdx]->getSize()) ? length : src[srcIdx]->getSize(); }
+    }
+}
+
 bool AggAccessor::srcIdxFromByteIdx(long byteIdx, int& srcIdx, long& offsetIdx)
 {
     if (byteIdx < 0)
@@ -174,3 +186,13 @@ IByteIterator* FileAccessor::iterator()
 {
     return new FileIterator<1024>(fp, offset, len, false);
 }
+
+// Asks the kernel to start reading the range into the page cache
+void FileAccessor::prefetch(long length)
+{
+    if (length == -1 || (len != -1 && length > len))
+    { length = len; }
+
+    // A length of 0 means up to the end of the file
+    posix_fadvise(fileno(fp), offset, (length == -1) ? 0 : length, POSIX_FADV_WILLNEED);
+}
@@ -8,10 +8,15 @@
 class IByteAccessor
 {
 public:
+    virtual ~IByteAccessor() {}
+
     virtual byte operator[](long) = 0;
     virtual long getSize() = 0;
     virtual IByteAccessor* subset(long, long) = 0;
     virtual IByteIterator* iterator() = 0;
+
+    // Hints that the first length bytes (all if -1) will be read soon, so they can be fetched ahead of time
+    virtual void prefetch(long length = -1) {}
 };
 
 class MemoryAccessor : public IByteAccessor
@@ -49,6 +54,7 @@ public:
     long getSize();
     IByteAccessor* subset(long, long);
     IByteIterator* iterator();
+    void prefetch(long length = -1);
 };
 
 class AggAccessor : public IByteAccessor
@@ -67,6 +73,7 @@ public:
     long getSize();
     IByteAccessor* subset(long, long);
     IByteIterator* iterator();
+    void prefetch(long length = -1);
 };
 
 #endif
@@ -1,5 +1,7 @@
 #include "byteIterator.h"
 
+#include <string.h>
+
 MemoryIterator::MemoryIterator(byte* src, long len) : _src(src), curr(src), _len(len) {}
 
 byte MemoryIterator::next()
@@ -19,6 +21,22 @@ void MemoryIterator::reset()
     curr = _src;
 }
 
+long MemoryIterator::getSize()
+{
+    return _len;
+}
+
+long MemoryIterator::read(byte* out, long n)
+{
+    long remaining = _src + _len - curr;
+    if (n > remaining)
+    { n = remaining; }
+
+    memcpy(out, curr, n);
+    curr += n;
+    return n;
+}
+
 AggIterator::AggIterator(IByteIterator* src[], int len)
 {
     this->src = (IByteIterator**)malloc(sizeof(IByteIterator*) * len);
@@ -63,3 +81,13 @@ void AggIterator::reset()
         this->src[srcIdx]->reset();
     }
 }
+
+long AggIterator::getSize()
+{
+    long totalLen = 0;
+    for (int srcIdx = 0; srcIdx < len; srcIdx++)
+    {
+        totalLen += src[srcIdx]->getSize();
+    }
+    return totalLen;
+}
@@ -20,9 +20,24 @@ template<class T>
 class IIterator
 {
 public:
+    virtual ~IIterator() {}
+
     virtual T next() = 0;
     virtual bool hasNext() = 0;
     virtual void reset() = 0;
+    virtual long getSize() = 0;  // Total number of elements, regardless of how many have been read
+
+    // Copies up to n elements into out, returning how many were read. Override where a block copy is cheaper.
+    virtual long read(T* out, long n)
+    {
+        long readCnt = 0;
+        while (readCnt < n && hasNext())
+        {
+            out[readCnt] = next();
+            readCnt++;
+        }
+        return readCnt;
+    }
 };
 
 typedef IIterator<byte> IByteIterator;
@@ -41,9 +56,12 @@ public:
     byte next();
     bool hasNext();
     void reset();
+    long getSize();
+    long read(byte* out, long n);
 };
 
 #include <stdio.h>
+#include <string.h>
 
 template<unsigned long BUFFER_SZ>
 class FileIterator : public IByteIterator
@@ -128,6 +146,36 @@ public:
         return bufferOffset < bufferBytes;
     }
 
+    long read(byte* out, long n)
+    {
+        long readCnt = 0;
+        while (readCnt < n && hasNext())
+        {
+            long chunk = bufferBytes - bufferOffset;
+            if (chunk > n - readCnt)
+            { chunk = n - readCnt; }
+
+            memcpy(out + readCnt, buffer + bufferOffset, chunk);
+            bufferOffset += chunk;
+            loc += chunk;
+            readCnt += chunk;
+        }
+        return readCnt;
+    }
+
+    long getSize()
+    {
+        if (end != -1)
+        { return end - start; }
+
+        long origPos = ftell(_fp);
+        fseek(_fp, 0L, SEEK_END);
+        long fileSize = ftell(_fp);
+        fseek(_fp, origPos, SEEK_SET);
+
+        return fileSize - start;
+    }
+
     void reset()
     {
         loc = start;
@@ -160,6 +208,7 @@ public:
     byte next();
     bool hasNext();
     void reset();
+    long getSize();
 };
 
 #endif
@@ -0,0 +1,574 @@
+#include "catalog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "hierarchy.h"
+#include "parser.h"
+#include "threadPool.h"
+#include "zipEntry.h"
+
+static const char MAGIC[8] = {'B', 'V', 'C', 'A', 'T', 'L', 'G', '1'};
+
+enum Column
+{
+    COL_ARCHIVE_PATH_OFFSETS,   // uint64_t, archiveCnt + 1
+    COL_ARCHIVE_PATHS,          // NUL-terminated strings
+    COL_ARCHIVE_SIZES,          // uint64_t
+    COL_ARCHIVE_MODIFIED,       // int64_t
+    COL_ARCHIVE_FIRST_ENTRIES,  // uint64_t, archiveCnt + 1
+    COL_ENTRY_ARCHIVES,         // uint32_t
+    COL_NAME_OFFSETS,           // uint64_t, entryCnt + 1
+    COL_NAMES,                  // NUL-terminated strings
+    COL_COMPRESSION_METHODS,    // uint16_t
+    COL_FLAGS,                  // uint16_t
+    COL_CRC32S,                 // uint32_t
+    COL_COMPRESSED_SIZES,       // uint64_t
+    COL_UNCOMPRESSED_SIZES,     // uint64_t
+    COL_MODIFIED,               // uint32_t
+    COL_LOCAL_HEADER_OFFSETS,   // uint64_t
+    COL_BY_NAME,                // uint32_t
+    COL_BY_REVERSED_NAME,       // uint32_t
+    COLUMN_CNT
+};
+
+// Starts the file, in host byte order. Columns follow, each at a multiple of 8 bytes.
+struct CatalogHeader
+{
+    char magic[8];
+    uint64_t archiveCnt;
+    uint64_t entryCnt;
+    uint64_t columnOffsets[COLUMN_CNT];
+    uint64_t columnSizes[COLUMN_CNT];
+};
+
+// Orders names as if each were spelled backwards, so names sharing a suffix sort together
+static int compareReversed(const char *a, size_t aLen, const char *b, size_t bLen)
+{
+    while (aLen > 0 && bLen > 0)
+    {
+        unsigned char aCh = a[--aLen];
+        unsigned char bCh = b[--bLen];
+        if (aCh != bCh)
+        { return (aCh < bCh) ? -1 : 1; }
+    }
+    if (aLen == bLen)
+    { return 0; }
+    return (aLen == 0) ? -1 : 1;
+}
+
+// Compares the end of name with suffix in reversed-name order: 0 if name ends with suffix
+static int compareSuffix(const char *name, size_t nameLen, const char *suffix, size_t suffixLen)
+{
+    for (size_t idx = 0; idx < suffixLen; idx++)
+    {
+        if (idx >= nameLen)
+        { return -1; }
+
+        unsigned char nameCh = name[nameLen - 1 - idx];
+        unsigned char suffixCh = suffix[suffixLen - 1 - idx];
+        if (nameCh != suffixCh)
+        { return (nameCh < suffixCh) ? -1 : 1; }
+    }
+    return 0;
+}
+
+// Checks offsets into a column of NUL-terminated strings, count + 1 of them: each string must end just before the next
+static bool validStringOffsets(const uint64_t *offsets, uint64_t count, const char *strings, uint64_t stringsSz)
+{
+    if (offsets[0] != 0 || offsets[count] != stringsSz)
+    { return false; }
+
+    for (uint64_t idx = 0; idx < count; idx++)
+    {
+        if (offsets[idx] >= offsets[idx + 1] || offsets[idx + 1] > stringsSz || strings[offsets[idx + 1] - 1] != '\0')
+        { return false; }
+    }
+    return true;
+}
+
+// Checks that every value is below limit
+static bool validIndices(const uint32_t *values, uint64_t count, uint64_t limit)
+{
+    for (uint64_t idx = 0; idx < count; idx++)
+    {
+        if (values[idx] >= limit)
+        { return false; }
+    }
+    return true;
+}
+
+Catalog::Catalog(const char *path) : data(NULL), dataSz(0), archiveCnt(0), entryCnt(0)
+{
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    { return; }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CatalogHeader))
+    {
+        close(fd);
+        return;
+    }
+
+    void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    { return; }
+
+    const CatalogHeader *header = (const CatalogHeader *)mapped;
+    const char *base = (const char *)mapped;
+    uint64_t archives = header->archiveCnt;
+    uint64_t entries = header->entryCnt;
+
+    // Sizes every column must have, or 0 where only the total is known
+    const uint64_t expectedSizes[COLUMN_CNT] = {
+        (archives + 1) * sizeof(uint64_t), 0, archives * sizeof(uint64_t), archives * sizeof(int64_t),
+        (archives + 1) * sizeof(uint64_t), entries * sizeof(uint32_t), (entries + 1) * sizeof(uint64_t), 0,
+        entries * sizeof(uint16_t), entries * sizeof(uint16_t), entries * sizeof(uint32_t), entries * sizeof(uint64_t),
+        entries * sizeof(uint64_t), entries * sizeof(uint32_t), entries * sizeof(uint64_t), entries * sizeof(uint32_t),
+        entries * sizeof(uint32_t)
+    };
+
+    // Counts no larger than the file keep the expected sizes from overflowing
+    bool valid = memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && archives <= (uint64_t)info.st_size && entries <= (uint64_t)info.st_size;
+    for (int col = 0; valid && col < COLUMN_CNT; col++)
+    {
+        uint64_t offset = header->columnOffsets[col];
+        uint64_t size = header->columnSizes[col];
+        valid = offset % 8 == 0 && offset <= (uint64_t)info.st_size && size <= info.st_size - offset &&
+            (expectedSizes[col] == 0 || size == expectedSizes[col]);
+    }
+    if (!valid)
+    {
+        munmap(mapped, info.st_size);
+        return;
+    }
+
+    data = mapped;
+    dataSz = info.st_size;
+    archiveCnt = archives;
+    entryCnt = entries;
+
+    archivePathOffsets = (const uint64_t *)(base + header->columnOffsets[COL_ARCHIVE_PATH_OFFSETS]);
+    archivePaths = base + header->columnOffsets[COL_ARCHIVE_PATHS];
+    archiveSizes = (const uint64_t *)(base + header->columnOffsets[COL_ARCHIVE_SIZES]);
+    archiveModified = (const int64_t *)(base + header->columnOffsets[COL_ARCHIVE_MODIFIED]);
+    archiveFirstEntries = (const uint64_t *)(base + header->columnOffsets[COL_ARCHIVE_FIRST_ENTRIES]);
+    entryArchives = (const uint32_t *)(base + header->columnOffsets[COL_ENTRY_ARCHIVES]);
+    nameOffsets = (const uint64_t *)(base + header->columnOffsets[COL_NAME_OFFSETS]);
+    names = base + header->columnOffsets[COL_NAMES];
+    compressionMethods = (const uint16_t *)(base + header->columnOffsets[COL_COMPRESSION_METHODS]);
+    flags = (const uint16_t *)(base + header->columnOffsets[COL_FLAGS]);
+    crc32s = (const uint32_t *)(base + header->columnOffsets[COL_CRC32S]);
+    compressedSizes = (const uint64_t *)(base + header->columnOffsets[COL_COMPRESSED_SIZES]);
+    uncompressedSizes = (const uint64_t *)(base + header->columnOffsets[COL_UNCOMPRESSED_SIZES]);
+    modified = (const uint32_t *)(base + header->columnOffsets[COL_MODIFIED]);
+    localHeaderOffsets = (const uint64_t *)(base + header->columnOffsets[COL_LOCAL_HEADER_OFFSETS]);
+    byName = (const uint32_t *)(base + header->columnOffsets[COL_BY_NAME]);
+    byReversedName = (const uint32_t *)(base + header->columnOffsets[COL_BY_REVERSED_NAME]);
+
+    // Offsets and indices are followed without checks from here on, so one out of range makes the catalog unusable
+    valid = validStringOffsets(archivePathOffsets, archives, archivePaths, header->columnSizes[COL_ARCHIVE_PATHS]) &&
+        validStringOffsets(nameOffsets, entries, names, header->columnSizes[COL_NAMES]) &&
+        archiveFirstEntries[0] == 0 && archiveFirstEntries[archives] == entries &&
+        validIndices(entryArchives, entries, archives) && validIndices(byName, entries, entries) &&
+        validIndices(byReversedName, entries, entries);
+    for (uint64_t archive = 0; valid && archive < archives; archive++)
+    {
+        valid = archiveFirstEntries[archive] <= archiveFirstEntries[archive + 1];
+    }
+    if (!valid)
+    {
+        munmap(data, dataSz);
+        data = NULL;
+        dataSz = 0;
+        archiveCnt = 0;
+        entryCnt = 0;
+    }
+}
+
+Catalog::~Catalog()
+{
+    if (data != NULL)
+    { munmap(data, dataSz); }
+}
+
+const char *Catalog::getArchivePath(long archive)
+{
+    return archivePaths + archivePathOffsets[archive];
+}
+
+CatalogEntry Catalog::getEntry(long entry)
+{
+    CatalogEntry out;
+    out.name = getName(entry);
+    out.compressionMethod = compressionMethods[entry];
+    out.flags = flags[entry];
+    out.crc32 = crc32s[entry];
+    out.compressedSize = compressedSizes[entry];
+    out.uncompressedSize = uncompressedSizes[entry];
+    out.modified = modified[entry];
+    out.localHeaderOffset = localHeaderOffsets[entry];
+    return out;
+}
+
+bool Catalog::matches(long entry, const CatalogQuery& query)
+{
+    return (query.compressionMethod < 0 || compressionMethods[entry] == query.compressionMethod) &&
+        compressedSizes[entry] >= query.minCompressedSize && compressedSizes[entry] <= query.maxCompressedSize &&
+        uncompressedSizes[entry] >= query.minUncompressedSize && uncompressedSizes[entry] <= query.maxUncompressedSize &&
+        (query.nameGlob == NULL || fnmatch(query.nameGlob, getName(entry), 0) == 0);
+}
+
+vector<long> Catalog::query(const CatalogQuery& query)
+{
+    // Only entries in [start, end) of order can match
+    const uint32_t *order = NULL;
+    long start = 0;
+    long end = entryCnt;
+
+    if (query.nameGlob != NULL)
+    {
+        const char *glob = query.nameGlob;
+        size_t globLen = strlen(glob);
+        size_t prefixLen = strcspn(glob, "*?[\\");
+
+        // The suffix starts after the last special character. With escapes anywhere, it is not worked out.
+        size_t suffixStart = globLen;
+        while (suffixStart > 0 && strchr("*?[]", glob[suffixStart - 1]) == NULL)
+        { suffixStart--; }
+        size_t suffixLen = (strchr(glob, '\\') == NULL) ? globLen - suffixStart : 0;
+
+        long prefixStart = partition_point(byName, byName + entryCnt, [this, glob, prefixLen](uint32_t entry) {
+            return strncmp(getName(entry), glob, prefixLen) < 0; }) - byName;
+        long prefixEnd = partition_point(byName + prefixStart, byName + entryCnt, [this, glob, prefixLen](uint32_t entry) {
+            return strncmp(getName(entry), glob, prefixLen) == 0; }) - byName;
+
+        const char *suffix = glob + suffixStart;
+        long suffixRangeStart = partition_point(byReversedName, byReversedName + entryCnt, [this, suffix, suffixLen](uint32_t entry) {
+            return compareSuffix(getName(entry), nameOffsets[entry + 1] - nameOffsets[entry] - 1, suffix, suffixLen) < 0; }) - byReversedName;
+        long suffixRangeEnd = partition_point(byReversedName + suffixRangeStart, byReversedName + entryCnt, [this, suffix, suffixLen](uint32_t entry) {
+            return compareSuffix(getName(entry), nameOffsets[entry + 1] - nameOffsets[entry] - 1, suffix, suffixLen) == 0; }) - byReversedName;
+
+        if (prefixEnd - prefixStart <= suffixRangeEnd - suffixRangeStart)
+        {
+            order = byName;
+            start = prefixStart;
+            end = prefixEnd;
+        } else {
+            order = byReversedName;
+            start = suffixRangeStart;
+            end = suffixRangeEnd;
+        }
+    }
+
+    vector<long> out;
+    for (long idx = start; idx < end; idx++)
+    {
+        long entry = (order != NULL) ? order[idx] : idx;
+        if (matches(entry, query))
+        { out.push_back(entry); }
+    }
+
+    if (order != NULL)
+    { sort(out.begin(), out.end()); }
+    return out;
+}
+
+CatalogEntry readCatalogEntry(Node *header)
+{
+    CatalogEntry entry;
+    entry.name = readNodeText(findChild(header, "File name"));
+    entry.compressionMethod = readNodeRawUInt(findChild(header, "Compression method"));
+    entry.flags = readNodeRawUInt(findChild(header, "Flags"));
+    entry.crc32 = readNodeRawUInt(findChild(header, "CRC-32 checksum"));
+    entry.compressedSize = readNodeRawUInt(findChild(header, "Compressed size"));
+    entry.uncompressedSize = readNodeRawUInt(findChild(header, "Uncompressed size"));
+    entry.modified = (readNodeRawUInt(findChild(header, "File modification date")) << 16) | readNodeRawUInt(findChild(header, "File modification time"));
+    entry.localHeaderOffset = readNodeRawUInt(findChild(header, "Offset of local header"));
+    return entry;
+}
+
+// Picks the central directory file headers out of a parse
+class CatalogVisitor : public TreeVisitor
+{
+public:
+    bool foundEnd;  // Whether an end of central directory record was seen
+
+    CatalogVisitor(vector<CatalogEntry>& out) : foundEnd(false), out(out) {}
+
+    void enter(Node *node, long offset, long length)
+    {
+        if (strcmp(node->description, "End of Central Directory Record") == 0)
+        { foundEnd = true; }
+
+        if (strcmp(node->description, "Central Directory File Header") != 0)
+        { return; }
+
+        out.push_back(readCatalogEntry(node));
+    }
+
+    void field(Node *node, long offset, long length) {}
+    void leave(Node *node) {}
+
+private:
+    vector<CatalogEntry>& out;
+};
+
+bool readCatalogEntries(FILE *fp, vector<CatalogEntry>& out)
+{
+    CatalogVisitor visitor(out);
+    parse(fp, visitor);
+    return visitor.foundEnd;
+}
+
+// Collects the columns of a new catalog, one archive at a time
+class CatalogBuilder
+{
+public:
+    CatalogBuilder()
+    {
+        archivePathOffsets.push_back(0);
+        archiveFirstEntries.push_back(0);
+        nameOffsets.push_back(0);
+    }
+
+    void addArchive(const string& path, uint64_t size, int64_t modified)
+    {
+        archivePaths.append(path.c_str(), path.size() + 1);
+        archivePathOffsets.push_back(archivePaths.size());
+        archiveSizes.push_back(size);
+        archiveModifiedTimes.push_back(modified);
+        archiveFirstEntries.push_back(archiveFirstEntries.back());
+    }
+
+    // Adds to the last archive added
+    void addEntry(const CatalogEntry& entry)
+    {
+        entryArchives.push_back(archiveSizes.size() - 1);
+        names.append(entry.name.c_str(), entry.name.size() + 1);
+        nameOffsets.push_back(names.size());
+        compressionMethods.push_back(entry.compressionMethod);
+        flags.push_back(entry.flags);
+        crc32s.push_back(entry.crc32);
+        compressedSizes.push_back(entry.compressedSize);
+        uncompressedSizes.push_back(entry.uncompressedSize);
+        modified.push_back(entry.modified);
+        localHeaderOffsets.push_back(entry.localHeaderOffset);
+        archiveFirstEntries.back()++;
+    }
+
+    long getEntryCnt() { return entryArchives.size(); }
+
+    // Writes to a temporary file beside path, then renames it over path. The temporary file's name is unique, so
+    // concurrent updates of the same catalog do not write over each other; the last to finish wins.
+    bool write(const char *path)
+    {
+        sortNames();
+
+        string tmpPath = string(path) + ".XXXXXX";
+        int fd = mkstemp(&tmpPath[0]);
+        if (fd < 0)
+        { return false; }
+
+        FILE *fp = fdopen(fd, "w");
+        if (fp == NULL || fchmod(fd, 0644) != 0)
+        {
+            if (fp != NULL)
+            {
+                fclose(fp);
+            } else {
+                close(fd);
+            }
+            unlink(tmpPath.c_str());
+            return false;
+        }
+
+        CatalogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.archiveCnt = archiveSizes.size();
+        header.entryCnt = entryArchives.size();
+
+        uint64_t offset = sizeof(header);
+        bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+        ok = ok && writeColumn(fp, &header, COL_ARCHIVE_PATH_OFFSETS, archivePathOffsets.data(), archivePathOffsets.size() * sizeof(uint64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_ARCHIVE_PATHS, archivePaths.data(), archivePaths.size(), &offset);
+        ok = ok && writeColumn(fp, &header, COL_ARCHIVE_SIZES, archiveSizes.data(), archiveSizes.size() * sizeof(uint64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_ARCHIVE_MODIFIED, archiveModifiedTimes.data(), archiveModifiedTimes.size() * sizeof(int64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_ARCHIVE_FIRST_ENTRIES, archiveFirstEntries.data(), archiveFirstEntries.size() * sizeof(uint64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_ENTRY_ARCHIVES, entryArchives.data(), entryArchives.size() * sizeof(uint32_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_NAME_OFFSETS, nameOffsets.data(), nameOffsets.size() * sizeof(uint64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_NAMES, names.data(), names.size(), &offset);
+        ok = ok && writeColumn(fp, &header, COL_COMPRESSION_METHODS, compressionMethods.data(), compressionMethods.size() * sizeof(uint16_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_FLAGS, flags.data(), flags.size() * sizeof(uint16_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_CRC32S, crc32s.data(), crc32s.size() * sizeof(uint32_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_COMPRESSED_SIZES, compressedSizes.data(), compressedSizes.size() * sizeof(uint64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_UNCOMPRESSED_SIZES, uncompressedSizes.data(), uncompressedSizes.size() * sizeof(uint64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_MODIFIED, modified.data(), modified.size() * sizeof(uint32_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_LOCAL_HEADER_OFFSETS, localHeaderOffsets.data(), localHeaderOffsets.size() * sizeof(uint64_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_BY_NAME, byName.data(), byName.size() * sizeof(uint32_t), &offset);
+        ok = ok && writeColumn(fp, &header, COL_BY_REVERSED_NAME, byReversedName.data(), byReversedName.size() * sizeof(uint32_t), &offset);
+
+        // The header goes in last, now that the columns' places are known
+        ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+        ok = (fclose(fp) == 0) && ok;
+
+        if (!ok || rename(tmpPath.c_str(), path) != 0)
+        {
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    vector<uint64_t> archivePathOffsets;
+    string archivePaths;
+    vector<uint64_t> archiveSizes;
+    vector<int64_t> archiveModifiedTimes;
+    vector<uint64_t> archiveFirstEntries;
+
+    vector<uint32_t> entryArchives;
+    vector<uint64_t> nameOffsets;
+    string names;
+    vector<uint16_t> compressionMethods;
+    vector<uint16_t> flags;
+    vector<uint32_t> crc32s;
+    vector<uint64_t> compressedSizes;
+    vector<uint64_t> uncompressedSizes;
+    vector<uint32_t> modified;
+    vector<uint64_t> localHeaderOffsets;
+
+    vector<uint32_t> byName;
+    vector<uint32_t> byReversedName;
+
+    void sortNames()
+    {
+        byName.resize(entryArchives.size());
+        for (size_t entry = 0; entry < byName.size(); entry++)
+        { byName[entry] = entry; }
+        byReversedName = byName;
+
+        const char *nameData = names.data();
+        const uint64_t *offsets = nameOffsets.data();
+        sort(byName.begin(), byName.end(), [nameData, offsets](uint32_t a, uint32_t b) {
+            return strcmp(nameData + offsets[a], nameData + offsets[b]) < 0; });
+        sort(byReversedName.begin(), byReversedName.end(), [nameData, offsets](uint32_t a, uint32_t b) {
+            return compareReversed(nameData + offsets[a], offsets[a + 1] - offsets[a] - 1, nameData + offsets[b], offsets[b + 1] - offsets[b] - 1) < 0; });
+    }
+
+    // Pads to a multiple of 8 bytes, then writes the column and records where it went
+    static bool writeColumn(FILE *fp, CatalogHeader *header, Column col, const void *data, size_t size, uint64_t *offset)
+    {
+        static const char PADDING[8] = {0};
+        size_t padding = (8 - *offset % 8) % 8;
+        if (padding > 0 && fwrite(PADDING, 1, padding, fp) != padding)
+        { return false; }
+        *offset += padding;
+
+        header->columnOffsets[col] = *offset;
+        header->columnSizes[col] = size;
+        *offset += size;
+        return size == 0 || fwrite(data, 1, size, fp) == size;
+    }
+};
+
+bool updateCatalog(const char *catalogPath, const vector<string>& paths, int threadCnt, CatalogStats *stats)
+{
+    Catalog old(catalogPath);
+
+    // Archives are matched to the old catalog by path
+    vector<long> oldArchives(paths.size(), -1);
+    vector<struct stat> infos(paths.size());
+    vector<char> readable(paths.size(), false);    // Opens and parses as a zip. Not vector<bool>: workers set their own elements.
+    {
+        unordered_map<string, long> oldByPath;
+        for (long archive = 0; archive < old.getArchiveCnt(); archive++)
+        { oldByPath[old.getArchivePath(archive)] = archive; }
+
+        for (size_t pathIdx = 0; pathIdx < paths.size(); pathIdx++)
+        {
+            readable[pathIdx] = stat(paths[pathIdx].c_str(), &infos[pathIdx]) == 0;
+            unordered_map<string, long>::iterator found = oldByPath.find(paths[pathIdx]);
+            if (!readable[pathIdx] || found == oldByPath.end())
+            { continue; }
+
+            int64_t modified = infos[pathIdx].st_mtim.tv_sec * 1000000000LL + infos[pathIdx].st_mtim.tv_nsec;
+            if (old.getArchiveSize(found->second) == (uint64_t)infos[pathIdx].st_size && old.getArchiveModified(found->second) == modified)
+            { oldArchives[pathIdx] = found->second; }
+        }
+    }
+
+    // Only new and changed archives are parsed
+    vector<vector<CatalogEntry> > parsed(paths.size());
+    {
+        ThreadPool pool(threadCnt);
+        for (size_t pathIdx = 0; pathIdx < paths.size(); pathIdx++)
+        {
+            if (!readable[pathIdx] || oldArchives[pathIdx] >= 0)
+            { continue; }
+
+            pool.submit([pathIdx, &paths, &parsed, &readable]() {
+                FILE *fp = fopen(paths[pathIdx].c_str(), "r");
+                if (fp == NULL)
+                {
+                    readable[pathIdx] = false;
+                    return;
+                }
+                readable[pathIdx] = readCatalogEntries(fp, parsed[pathIdx]);
+                fclose(fp);
+            });
+        }
+        pool.wait();
+    }
+
+    CatalogBuilder builder;
+    long reusedCnt = 0;
+    long failedCnt = 0;
+    for (size_t pathIdx = 0; pathIdx < paths.size(); pathIdx++)
+    {
+        if (!readable[pathIdx])
+        {
+            failedCnt++;
+            continue;
+        }
+
+        int64_t modified = infos[pathIdx].st_mtim.tv_sec * 1000000000LL + infos[pathIdx].st_mtim.tv_nsec;
+        builder.addArchive(paths[pathIdx], infos[pathIdx].st_size, modified);
+
+        long oldArchive = oldArchives[pathIdx];
+        if (oldArchive >= 0)
+        {
+            for (long entry = old.getFirstEntry(oldArchive); entry < old.getEntryEnd(oldArchive); entry++)
+            { builder.addEntry(old.getEntry(entry)); }
+            reusedCnt++;
+            continue;
+        }
+
+        vector<CatalogEntry>& entries = parsed[pathIdx];
+        for (vector<CatalogEntry>::iterator iter = entries.begin(); iter < entries.end(); iter++)
+        { builder.addEntry(*iter); }
+        vector<CatalogEntry>().swap(entries);
+    }
+
+    if (stats != NULL)
+    {
+        stats->archiveCnt = paths.size() - failedCnt;
+        stats->reusedCnt = reusedCnt;
+        stats->failedCnt = failedCnt;
+        stats->entryCnt = builder.getEntryCnt();
+    }
+
+    return builder.write(catalogPath);
+}
@@ -0,0 +1,126 @@
+#ifndef BINVIEW_CATALOG
+#define BINVIEW_CATALOG
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <string>
+#include <vector>
+
+#include "hierarchy.h"
+
+using namespace std;
+
+// One archive member as listed by its central directory file header
+struct CatalogEntry
+{
+    string name;
+    uint16_t compressionMethod;
+    uint16_t flags;
+    uint32_t crc32;
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
+    uint32_t modified;      // MS-DOS date in the high 16 bits, time in the low 16
+    uint64_t localHeaderOffset;
+};
+
+// Entries match when every condition set matches. Unset conditions match everything.
+struct CatalogQuery
+{
+    const char *nameGlob;   // fnmatch() pattern on the whole name, so "*" also matches "/"
+    int compressionMethod;  // -1 for any
+    uint64_t minCompressedSize;
+    uint64_t maxCompressedSize;
+    uint64_t minUncompressedSize;
+    uint64_t maxUncompressedSize;
+
+    CatalogQuery() : nameGlob(NULL), compressionMethod(-1), minCompressedSize(0), maxCompressedSize(UINT64_MAX),
+        minUncompressedSize(0), maxUncompressedSize(UINT64_MAX) {}
+};
+
+struct CatalogStats
+{
+    long archiveCnt;
+    long reusedCnt;     // Archives unchanged since the last update, whose entries were copied rather than parsed
+    long failedCnt;     // Archives that could not be read or did not parse as zips, and were left out
+    long entryCnt;
+};
+
+/*
+ * An on-disk index of the entries of many archives, read through mmap() without parsing anything.
+ *
+ * Each field is stored as its own column: an array of fixed-size values, one per entry, with entries grouped by
+ * archive. Names are kept in a blob of NUL-terminated strings, and two name indexes hold the entries sorted by name
+ * and by reversed name. A glob starting with literal text such as "lib/", or ending with literal text such as ".so",
+ * only looks at the range of entries sharing it; other conditions are checked against the columns.
+ */
+class Catalog
+{
+public:
+    Catalog(const char *path);
+    ~Catalog();
+
+    bool isOpen() { return data != NULL; }
+
+    long getArchiveCnt() { return archiveCnt; }
+    long getEntryCnt() { return entryCnt; }
+
+    const char *getArchivePath(long archive);
+    uint64_t getArchiveSize(long archive) { return archiveSizes[archive]; }
+    int64_t getArchiveModified(long archive) { return archiveModified[archive]; }  // Nanoseconds since the epoch
+    long getFirstEntry(long archive) { return archiveFirstEntries[archive]; }
+    long getEntryEnd(long archive) { return archiveFirstEntries[archive + 1]; }
+
+    long getEntryArchive(long entry) { return entryArchives[entry]; }
+    const char *getName(long entry) { return names + nameOffsets[entry]; }
+    CatalogEntry getEntry(long entry);
+
+    // Returns the matching entries in catalog order
+    vector<long> query(const CatalogQuery& query);
+
+private:
+    void *data;
+    size_t dataSz;
+
+    long archiveCnt;
+    long entryCnt;
+
+    const uint64_t *archivePathOffsets;
+    const char *archivePaths;
+    const uint64_t *archiveSizes;
+    const int64_t *archiveModified;
+    const uint64_t *archiveFirstEntries;    // archiveCnt + 1 of them
+
+    const uint32_t *entryArchives;
+    const uint64_t *nameOffsets;
+    const char *names;
+    const uint16_t *compressionMethods;
+    const uint16_t *flags;
+    const uint32_t *crc32s;
+    const uint64_t *compressedSizes;
+    const uint64_t *uncompressedSizes;
+    const uint32_t *modified;
+    const uint64_t *localHeaderOffsets;
+
+    const uint32_t *byName;
+    const uint32_t *byReversedName;
+
+    bool matches(long entry, const CatalogQuery& query);
+};
+
+/*
+ * Brings the catalog at catalogPath up to date with the archives at paths, creating it if needed. Archives whose size
+ * and modification time are unchanged keep their entries; the others are parsed concurrently on threadCnt workers
+ * (0 means one per core). Archives not in paths are dropped. The new catalog replaces the old one atomically.
+ * Returns false if the catalog could not be written.
+ */
+bool updateCatalog(const char *catalogPath, const vector<string>& paths, int threadCnt, CatalogStats *stats = NULL);
+
+// Reads the fields of a "Central Directory File Header" node, which must be in a tree with a data node (see getDataNode())
+CatalogEntry readCatalogEntry(Node *header);
+
+// Appends the entries listed by the central directory of the zip file. Returns false if it does not parse as a zip,
+// that is, no end of central directory record was found.
+bool readCatalogEntries(FILE *fp, vector<CatalogEntry>& out);
+
+#endif
@@ -0,0 +1,184 @@
+#include "crc32.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BINVIEW_CRC32_CLMUL
+#endif
+
+static const uint32_t POLYNOMIAL = 0xEDB88320;
+
+// tables[0] is the classic byte-at-a-time table. tables[n][b] is the CRC of byte b followed by n zero bytes.
+struct Crc32Tables
+{
+    uint32_t tables[16][256];
+
+    Crc32Tables()
+    {
+        for (uint32_t value = 0; value < 256; value++)
+        {
+            uint32_t crc = value;
+            for (int bitIdx = 0; bitIdx < 8; bitIdx++)
+            {
+                crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+            }
+            tables[0][value] = crc;
+        }
+
+        for (int tableIdx = 1; tableIdx < 16; tableIdx++)
+        {
+            for (int value = 0; value < 256; value++)
+            {
+                uint32_t prev = tables[tableIdx - 1][value];
+                tables[tableIdx][value] = (prev >> 8) ^ tables[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+static inline uint32_t load32(const byte* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Operates on the raw (non-inverted) CRC register
+static uint32_t crc32Slicing16(uint32_t crc, const byte* data, size_t len)
+{
+    static const Crc32Tables crcTables;  // Built on first use
+    const uint32_t (*t)[256] = crcTables.tables;
+
+    while (len >= 16)
+    {
+        uint32_t a = load32(data) ^ crc;
+        uint32_t b = load32(data + 4);
+        uint32_t c = load32(data + 8);
+        uint32_t d = load32(data + 12);
+
+        crc = t[15][a & 0xFF] ^ t[14][(a >> 8) & 0xFF] ^ t[13][(a >> 16) & 0xFF] ^ t[12][a >> 24]
+            ^ t[11][b & 0xFF] ^ t[10][(b >> 8) & 0xFF] ^ t[9][(b >> 16) & 0xFF] ^ t[8][b >> 24]
+            ^ t[7][c & 0xFF] ^ t[6][(c >> 8) & 0xFF] ^ t[5][(c >> 16) & 0xFF] ^ t[4][c >> 24]
+            ^ t[3][d & 0xFF] ^ t[2][(d >> 8) & 0xFF] ^ t[1][(d >> 16) & 0xFF] ^ t[0][d >> 24];
+
+        data += 16;
+        len -= 16;
+    }
+
+    while (len > 0)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+        data++;
+        len--;
+    }
+
+    return crc;
+}
+
+#ifdef BINVIEW_CRC32_CLMUL
+/*
+ * Folds the buffer 64 bytes at a time with carry-less multiplication, then Barrett-reduces to 32 bits.
+ * See Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * len must be at least 64 and a multiple of 16. Operates on the raw (non-inverted) CRC register.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32Clmul(uint32_t crc, const byte* data, size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    __m128i x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    __m128i x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    __m128i x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+    data += 64;
+    len -= 64;
+
+    // Fold four 128-bit lanes in parallel
+    while (len >= 64)
+    {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 0x30)));
+
+        data += 64;
+        len -= 64;
+    }
+
+    // Fold the four lanes into one
+    __m128i lanes[] = {x2, x3, x4};
+    for (int laneIdx = 0; laneIdx < 3; laneIdx++)
+    {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, lanes[laneIdx]), x5);
+    }
+
+    // Fold any remaining 16-byte blocks
+    while (len >= 16)
+    {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)data)), x5);
+
+        data += 16;
+        len -= 16;
+    }
+
+    // 128 bits down to 64
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction down to 32
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return _mm_extract_epi32(x1, 1);
+}
+
+static bool hasClmul()
+{
+    static bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+#endif
+
+uint32_t crc32Update(uint32_t crc, const byte* data, size_t len)
+{
+    crc = ~crc;
+
+#ifdef BINVIEW_CRC32_CLMUL
+    if (len >= 64 && hasClmul())
+    {
+        size_t foldLen = len & ~(size_t)15;
+        crc = crc32Clmul(crc, data, foldLen);
+        data += foldLen;
+        len -= foldLen;
+    }
+#endif
+
+    crc = crc32Slicing16(crc, data, len);
+
+    return ~crc;
+}
@@ -0,0 +1,16 @@
+#ifndef BINVIEW_CRC32
+#define BINVIEW_CRC32
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "byteIterator.h"
+
+/*
+ * CRC-32 as used by zip (reflected polynomial 0xEDB88320).
+ * Pass 0 to start a new checksum, or the previous return value to continue one.
+ * Uses carry-less multiplication (PCLMULQDQ) when the CPU supports it and slicing-by-16 otherwise.
+ */
+uint32_t crc32Update(uint32_t crc, const byte* data, size_t len);
+
+#endif
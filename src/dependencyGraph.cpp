@@ -0,0 +1,104 @@
+#include "dependencyGraph.h"
+
+#include <deque>
+#include <unordered_set>
+
+DependencyGraph::DependencyGraph(Node* root) : root(root), index(root)
+{
+    addNode(root);
+}
+
+void DependencyGraph::addNode(Node* node)
+{
+    nodes.push_back(node);
+
+    if (node->pInterpretation != NULL)
+    {
+        vector<Node*> nodeDependencies;
+        node->pInterpretation->getDependencies(nodeDependencies);
+
+        for (vector<Node*>::iterator iter = nodeDependencies.begin(); iter < nodeDependencies.end(); iter++)
+        {
+            dependents[*iter].push_back(node);
+        }
+        dependencies[node] = nodeDependencies;
+    }
+
+    for (Node* child = node->firstChild; child != NULL; child = child->nextSibling)
+    {
+        addNode(child);
+    }
+}
+
+const vector<Node*>& DependencyGraph::getDependents(Node* node)
+{
+    static const vector<Node*> none;
+
+    unordered_map<Node*, vector<Node*> >::iterator found = dependents.find(node);
+    return found == dependents.end() ? none : found->second;
+}
+
+vector<Node*> DependencyGraph::findOverlapping(long offset, long length)
+{
+    return index.findOverlapping(offset, length);
+}
+
+vector<Node*> DependencyGraph::affectedBy(const vector<Node*>& changed)
+{
+    // Collect everything reachable from the changed nodes
+    unordered_set<Node*> affected;
+    deque<Node*> pending(changed.begin(), changed.end());
+    while (!pending.empty())
+    {
+        Node* node = pending.front();
+        pending.pop_front();
+        if (!affected.insert(node).second)
+        { continue; }
+
+        const vector<Node*>& nodeDependents = getDependents(node);
+        pending.insert(pending.end(), nodeDependents.begin(), nodeDependents.end());
+    }
+
+    // Kahn's algorithm over the affected nodes, counting only dependencies that are themselves affected
+    unordered_map<Node*, int> waitingOn;
+    for (unordered_set<Node*>::iterator iter = affected.begin(); iter != affected.end(); iter++)
+    {
+        int cnt = 0;
+        vector<Node*>& nodeDependencies = dependencies[*iter];
+        for (vector<Node*>::iterator dep = nodeDependencies.begin(); dep < nodeDependencies.end(); dep++)
+        {
+            if (affected.count(*dep))
+            { cnt++; }
+        }
+        waitingOn[*iter] = cnt;
+    }
+
+    // Seed in tree order so the result is deterministic
+    vector<Node*> ordered;
+    for (vector<Node*>::iterator iter = nodes.begin(); iter < nodes.end(); iter++)
+    {
+        if (affected.count(*iter) && waitingOn[*iter] == 0)
+        { ordered.push_back(*iter); }
+    }
+
+    for (size_t orderedIdx = 0; orderedIdx < ordered.size(); orderedIdx++)
+    {
+        const vector<Node*>& nodeDependents = getDependents(ordered[orderedIdx]);
+        for (vector<Node*>::const_iterator dep = nodeDependents.begin(); dep < nodeDependents.end(); dep++)
+        {
+            if (affected.count(*dep) && --waitingOn[*dep] == 0)
+            { ordered.push_back(*dep); }
+        }
+    }
+
+    if (ordered.size() < affected.size())
+    {
+        for (vector<Node*>::iterator iter = nodes.begin(); iter < nodes.end(); iter++)
+        {
+            if (affected.count(*iter) && waitingOn[*iter] > 0)
+            { ordered.push_back(*iter); }
+        }
+    }
+
+    return ordered;
+}
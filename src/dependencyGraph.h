@@ -0,0 +1,42 @@
+#ifndef BINVIEW_DEPENDENCY_GRAPH
+#define BINVIEW_DEPENDENCY_GRAPH
+
+#include <unordered_map>
+#include <vector>
+
+#include "hierarchy.h"
+#include "nodeIndex.h"
+
+using namespace std;
+
+/* Records which nodes' values are computed from which other nodes, as reported by
+ * Interpretation::getDependencies, so a change can be traced to everything it affects.
+ *
+ * The graph is a snapshot: rebuild it if nodes are added to or removed from the tree.
+ */
+class DependencyGraph
+{
+public:
+    DependencyGraph(Node* root);
+
+    // Nodes computed directly from node
+    const vector<Node*>& getDependents(Node* node);
+
+    // Nodes whose bytes overlap [offset, offset + length) of the file
+    vector<Node*> findOverlapping(long offset, long length);
+
+    // changed plus everything computed from it, transitively, ordered so each node comes after the nodes it
+    // depends on. Nodes caught in a cycle are placed last.
+    vector<Node*> affectedBy(const vector<Node*>& changed);
+
+private:
+    Node* root;
+    NodeIndex index;
+    vector<Node*> nodes;
+    unordered_map<Node*, vector<Node*> > dependents;
+    unordered_map<Node*, vector<Node*> > dependencies;
+
+    void addNode(Node* node);
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include "dump.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+#include "hierarchy.h"
+#include "parser.h"
+#include "formatCache.h"
+#include "threadPool.h"
+
+// A file's records are handed over for writing once this many bytes have built up
+static const size_t CHUNK_SZ = 64 * 1024;
+
+static void appendVarint(string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+static void appendBinaryString(string& out, const char *text, size_t len)
+{
+    appendVarint(out, len);
+    out.append(text, len);
+}
+
+static void appendJsonString(string& out, const char *text, size_t len)
+{
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+
+    out += '"';
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        unsigned char ch = text[idx];
+        if (ch == '"' || ch == '\\')
+        {
+            out += '\\';
+            out += ch;
+        } else if (ch < 0x20) {
+            out += "\\u00";
+            out += HEX_DIGITS[ch >> 4];
+            out += HEX_DIGITS[ch & 0xF];
+        } else {
+            out += ch;
+        }
+    }
+    out += '"';
+}
+
+// Writes the workers' records to out one chunk at a time. For ordered output, the file whose turn it is goes straight
+// through. Files ahead of their turn hold back no more than a chunk in memory and spill the rest to a temporary file,
+// which is copied out when their turn comes.
+class DumpWriter
+{
+public:
+    DumpWriter(FILE *out, bool ordered) : out(out), ordered(ordered), nextFile(0), bytesWritten(0) {}
+
+    ~DumpWriter()
+    {
+        for (map<long, FILE*>::iterator iter = spills.begin(); iter != spills.end(); iter++)
+        {
+            fclose(iter->second);
+        }
+    }
+
+    // Takes the file's records so far out of buffer, unless they must wait for the file's turn and are less than a
+    // chunk. last marks the file's final records.
+    void emit(long fileIdx, string& buffer, bool last)
+    {
+        unique_lock<mutex> guard(lock);
+
+        if (ordered && fileIdx != nextFile)
+        {
+            if (buffer.size() >= CHUNK_SZ)
+            { spill(fileIdx, buffer); }
+            if (last)
+            { finished[fileIdx].swap(buffer); }
+            return;
+        }
+
+        // What it spilled before its turn came
+        copySpill(fileIdx);
+        write(buffer);
+        buffer.clear();
+
+        if (ordered && last)
+        {
+            nextFile++;
+            for (map<long, string>::iterator found = finished.find(nextFile); found != finished.end(); found = finished.find(nextFile))
+            {
+                copySpill(nextFile);
+                write(found->second);
+                finished.erase(found);
+                nextFile++;
+            }
+            turnTaken.notify_all();
+        }
+    }
+
+    // For ordered output, blocks until file fileIdx is less than window files past the one whose turn it is
+    void waitForTurn(long fileIdx, long window)
+    {
+        unique_lock<mutex> guard(lock);
+        while (fileIdx - nextFile >= window)
+        { turnTaken.wait(guard); }
+    }
+
+    uint64_t getBytesWritten()
+    {
+        unique_lock<mutex> guard(lock);
+        return bytesWritten;
+    }
+
+private:
+    FILE *out;
+    bool ordered;
+
+    mutex lock;
+    condition_variable turnTaken;
+    long nextFile;
+    map<long, FILE*> spills;        // Records of files waiting for their turn, beyond what is held in memory
+    map<long, string> finished;     // Final records of files waiting for their turn, after any spilled ones
+    uint64_t bytesWritten;
+
+    // Caller holds lock
+    void write(const char *text, size_t len)
+    {
+        fwrite(text, 1, len, out);
+        bytesWritten += len;
+    }
+
+    void write(const string& text) { write(text.data(), text.size()); }
+
+    // Moves buffer to the end of the file's spill. If no temporary file can be made, buffer is left to grow.
+    // Caller holds lock.
+    void spill(long fileIdx, string& buffer)
+    {
+        FILE *&spillFp = spills[fileIdx];
+        if (spillFp == NULL)
+        { spillFp = tmpfile(); }
+        if (spillFp == NULL)
+        {
+            spills.erase(fileIdx);
+            return;
+        }
+
+        fwrite(buffer.data(), 1, buffer.size(), spillFp);
+        buffer.clear();
+    }
+
+    // Caller holds lock
+    void copySpill(long fileIdx)
+    {
+        map<long, FILE*>::iterator found = spills.find(fileIdx);
+        if (found == spills.end())
+        { return; }
+
+        char chunk[CHUNK_SZ];
+        rewind(found->second);
+        for (size_t len = fread(chunk, 1, sizeof(chunk), found->second); len > 0; len = fread(chunk, 1, sizeof(chunk), found->second))
+        {
+            write(chunk, len);
+        }
+
+        fclose(found->second);
+        spills.erase(found);
+    }
+};
+
+// One file's dump in progress. Records are written as the parser reads them, so the tree is never held.
+class FileDump : public TreeVisitor
+{
+public:
+    long fileIdx;
+    const DumpOptions *options;
+    DumpWriter *writer;
+    string buffer;
+    long nodeCnt;
+    vector<long> openNodes;     // Ids of the nodes entered and not yet left
+
+    void enter(Node *node, long offset, long length);
+    void field(Node *node, long offset, long length);
+    void leave(Node *node) { openNodes.pop_back(); }
+};
+
+static void appendFileRecord(FileDump& dump, const string& path)
+{
+    if (dump.options->format == DUMP_BINARY)
+    {
+        dump.buffer += 'F';
+        appendVarint(dump.buffer, dump.fileIdx);
+        appendBinaryString(dump.buffer, path.data(), path.size());
+        return;
+    }
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "{\"file\":%ld,\"path\":", dump.fileIdx);
+    dump.buffer += prefix;
+    appendJsonString(dump.buffer, path.data(), path.size());
+    dump.buffer += "}\n";
+}
+
+static void appendEndRecord(FileDump& dump, const char *error)
+{
+    if (dump.options->format == DUMP_BINARY)
+    {
+        dump.buffer += 'E';
+        appendVarint(dump.buffer, dump.fileIdx);
+        appendVarint(dump.buffer, dump.nodeCnt);
+        appendBinaryString(dump.buffer, error, (error != NULL) ? strlen(error) : 0);
+        return;
+    }
+
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "{\"file\":%ld,\"end\":true,\"nodes\":%ld", dump.fileIdx, dump.nodeCnt);
+    dump.buffer += prefix;
+    if (error != NULL)
+    {
+        dump.buffer += ",\"error\":";
+        appendJsonString(dump.buffer, error, strlen(error));
+    }
+    dump.buffer += "}\n";
+}
+
+static void appendNodeRecord(FileDump& dump, const Node *node, long nodeId, long parentId, long offset, long length, const string& value)
+{
+    if (dump.options->format == DUMP_BINARY)
+    {
+        dump.buffer += 'N';
+        appendVarint(dump.buffer, dump.fileIdx);
+        appendVarint(dump.buffer, nodeId);
+        appendVarint(dump.buffer, parentId + 1);
+        appendVarint(dump.buffer, offset);
+        appendVarint(dump.buffer, length);
+        appendBinaryString(dump.buffer, node->description, strlen(node->description));
+        appendBinaryString(dump.buffer, value.data(), value.size());
+        appendBinaryString(dump.buffer, node->annotation, (node->annotation != NULL) ? strlen(node->annotation) : 0);
+        return;
+    }
+
+    char prefix[96];
+    snprintf(prefix, sizeof(prefix), "{\"file\":%ld,\"node\":%ld,", dump.fileIdx, nodeId);
+    dump.buffer += prefix;
+    if (parentId >= 0)
+    {
+        snprintf(prefix, sizeof(prefix), "\"parent\":%ld,", parentId);
+        dump.buffer += prefix;
+    }
+    dump.buffer += "\"description\":";
+    appendJsonString(dump.buffer, node->description, strlen(node->description));
+    snprintf(prefix, sizeof(prefix), ",\"offset\":%ld,\"length\":%ld,\"value\":", offset, length);
+    dump.buffer += prefix;
+    appendJsonString(dump.buffer, value.data(), value.size());
+    if (node->annotation != NULL)
+    {
+        dump.buffer += ",\"annotation\":";
+        appendJsonString(dump.buffer, node->annotation, strlen(node->annotation));
+    }
+    dump.buffer += "}\n";
+}
+
+void FileDump::enter(Node *node, long offset, long length)
+{
+    field(node, offset, length);
+    openNodes.push_back(nodeCnt - 1);
+}
+
+void FileDump::field(Node *node, long offset, long length)
+{
+    long parentId = openNodes.empty() ? -1 : openNodes.back();
+    appendNodeRecord(*this, node, nodeCnt++, parentId, offset, length, formatNode(node, LOCALE_EN_US, options->maxValueLen));
+
+    if (buffer.size() >= CHUNK_SZ)
+    { writer->emit(fileIdx, buffer, false); }
+}
+
+// Returns false if the file could not be read
+static bool dumpFile(long fileIdx, const string& path, const DumpOptions& options, DumpWriter& writer, long *nodeCnt)
+{
+    FileDump dump;
+    dump.fileIdx = fileIdx;
+    dump.options = &options;
+    dump.writer = &writer;
+    dump.nodeCnt = 0;
+
+    appendFileRecord(dump, path);
+
+    FILE *fp = fopen(path.c_str(), "r");
+    if (fp == NULL)
+    {
+        appendEndRecord(dump, strerror(errno));
+        writer.emit(fileIdx, dump.buffer, true);
+        return false;
+    }
+
+    parse(fp, dump);
+    fclose(fp);
+
+    appendEndRecord(dump, NULL);
+    writer.emit(fileIdx, dump.buffer, true);
+
+    *nodeCnt = dump.nodeCnt;
+    return true;
+}
+
+static long fileSize(const string& path)
+{
+    struct stat info;
+    return (stat(path.c_str(), &info) == 0) ? info.st_size : 0;
+}
+
+long dumpFiles(const vector<string>& paths, FILE *out, const DumpOptions& options, DumpStats *stats)
+{
+    // Unordered output can start the largest files first, so a big file is not left running alone at the end
+    vector<long> schedule;
+    for (long fileIdx = 0; fileIdx < (long)paths.size(); fileIdx++)
+    {
+        schedule.push_back(fileIdx);
+    }
+    if (!options.ordered)
+    {
+        vector<long> sizes;
+        for (vector<string>::const_iterator iter = paths.begin(); iter < paths.end(); iter++)
+        {
+            sizes.push_back(fileSize(*iter));
+        }
+        stable_sort(schedule.begin(), schedule.end(), [&sizes](long a, long b) { return sizes[a] > sizes[b]; });
+    }
+
+    DumpWriter writer(out, options.ordered);
+    atomic<long> failedCnt(0);
+    atomic<long> nodeCnt(0);
+
+    ThreadPool pool(options.threadCnt);
+
+    // Files finished ahead of their turn are held in memory, so only this many may be under way past it
+    long window = pool.getThreadCnt() * 4;
+
+    for (vector<long>::iterator iter = schedule.begin(); iter < schedule.end(); iter++)
+    {
+        long fileIdx = *iter;
+        if (options.ordered)
+        { writer.waitForTurn(fileIdx, window); }
+
+        pool.submit([fileIdx, &paths, &options, &writer, &failedCnt, &nodeCnt]() {
+            long fileNodeCnt = 0;
+            if (!dumpFile(fileIdx, paths[fileIdx], options, writer, &fileNodeCnt))
+            { failedCnt++; }
+            nodeCnt += fileNodeCnt;
+        });
+    }
+    pool.wait();
+    fflush(out);
+
+    if (stats != NULL)
+    {
+        stats->fileCnt = paths.size();
+        stats->failedCnt = failedCnt;
+        stats->nodeCnt = nodeCnt;
+        stats->bytesWritten = writer.getBytesWritten();
+    }
+
+    return failedCnt;
+}
@@ -0,0 +1,66 @@
+#ifndef BINVIEW_DUMP
+#define BINVIEW_DUMP
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <string>
+#include <vector>
+
+#include "interpretation.h"
+
+using namespace std;
+
+enum DumpFormat
+{
+    DUMP_JSON_LINES,
+    DUMP_BINARY
+};
+
+struct DumpOptions
+{
+    DumpFormat format;
+    bool ordered;       // Files come out in the order given. Otherwise each comes out as soon as it is ready.
+    int threadCnt;      // 0 means one per core
+    long maxValueLen;   // Longer values are cut short, as in the viewer
+
+    DumpOptions() : format(DUMP_JSON_LINES), ordered(true), threadCnt(0), maxValueLen(1024) {}
+};
+
+struct DumpStats
+{
+    long fileCnt;
+    long failedCnt;     // Files that could not be read
+    long nodeCnt;
+    uint64_t bytesWritten;
+};
+
+/*
+ * Parses each file and writes its tree to out, for batch processing without the viewer.
+ * Files are parsed concurrently on options.threadCnt workers. Records are written as they are parsed, so memory
+ * does not grow with the number of entries.
+ *
+ * For ordered output, a file parsed ahead of its turn keeps about 64 KB of records in memory at most; the rest go to a
+ * temporary file until its turn. With at most threadCnt * 4 files under way, memory stays within about
+ * threadCnt * 4 * 64 KB of records whatever the size of the files.
+ *
+ * Every file produces a file record, one record per node in depth-first order, then an end record.
+ * Records of different files may interleave when options.ordered is false, so each carries the file's index
+ * into paths. Nodes are numbered from 0 per file, the root being 0; offsets are from the start of the file.
+ *
+ * JSON Lines, one object per line:
+ *   {"file":0,"path":"a.zip"}
+ *   {"file":0,"node":1,"parent":0,"description":"Local File Header","offset":0,"length":46,"value":"a.txt"}
+ *   {"file":0,"end":true,"nodes":2}       or with "error":"..." when the file could not be read
+ * The root has no "parent". Nodes with an annotation also get an "annotation" field.
+ *
+ * Binary: a tag byte, then unsigned LEB128 integers and strings (a length, then that many bytes):
+ *   'F' file, path
+ *   'N' file, node, parent + 1 (0 for the root), offset, length, description, value, annotation ("" if none)
+ *   'E' file, node count, error ("" if none)
+ *
+ * Returns the number of files that could not be read. Reasons are reported in their end records.
+ */
+long dumpFiles(const vector<string>& paths, FILE *out, const DumpOptions& options, DumpStats *stats = NULL);
+
+#endif
@@ -0,0 +1,247 @@
+#include "entryTable.h"
+
+#include <fnmatch.h>
+#include <regex.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "catalog.h"
+#include "threadPool.h"
+
+// Below this many rows per worker, splitting the work costs more than it saves
+static const long MIN_CHUNK_ROWS = 32 * 1024;
+
+/* Sorts items on up to chunkCnt workers: each sorts a chunk of its own, then the chunks are merged pairwise, the
+ * merges of each round also running concurrently.
+ */
+template <class T, class Less>
+static void parallelSort(vector<T>& items, Less less, long chunkCnt)
+{
+    if (chunkCnt <= 1)
+    {
+        std::sort(items.begin(), items.end(), less);
+        return;
+    }
+
+    vector<long> bounds;
+    for (long chunk = 0; chunk <= chunkCnt; chunk++)
+    {
+        bounds.push_back(items.size() * chunk / chunkCnt);
+    }
+
+    ThreadPool pool(chunkCnt);
+    for (long chunk = 0; chunk < chunkCnt; chunk++)
+    {
+        typename vector<T>::iterator start = items.begin() + bounds[chunk];
+        typename vector<T>::iterator end = items.begin() + bounds[chunk + 1];
+        pool.submit([start, end, less]() { std::sort(start, end, less); });
+    }
+    pool.wait();
+
+    for (long width = 1; width < chunkCnt; width *= 2)
+    {
+        for (long first = 0; first + width < chunkCnt; first += width * 2)
+        {
+            typename vector<T>::iterator start = items.begin() + bounds[first];
+            typename vector<T>::iterator middle = items.begin() + bounds[first + width];
+            typename vector<T>::iterator end = items.begin() + bounds[min(first + width * 2, chunkCnt)];
+            pool.submit([start, middle, end, less]() { inplace_merge(start, middle, end, less); });
+        }
+        pool.wait();
+    }
+}
+
+// FNV-1a
+size_t EntryTable::NameHash::operator()(uint32_t nameId) const
+{
+    size_t hash = 14695981039346656037ULL;
+    for (const char *ch = table->namePool.data() + table->nameOffsets[nameId]; *ch != '\0'; ch++)
+    {
+        hash = (hash ^ (unsigned char)*ch) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool EntryTable::NameEqual::operator()(uint32_t a, uint32_t b) const
+{
+    const char *pool = table->namePool.data();
+    return strcmp(pool + table->nameOffsets[a], pool + table->nameOffsets[b]) == 0;
+}
+
+EntryTable::EntryTable(int threadCnt) :
+    threadCnt((threadCnt > 0) ? threadCnt : ThreadPool::defaultThreadCnt()),
+    nameIdsByName(0, NameHash{this}, NameEqual{this})
+{}
+
+void EntryTable::add(Node *header)
+{
+    CatalogEntry entry = readCatalogEntry(header);
+
+    headers.push_back(header);
+    nameIds.push_back(intern(entry.name));
+    compressedSizes.push_back(entry.compressedSize);
+    uncompressedSizes.push_back(entry.uncompressedSize);
+    compressionMethods.push_back(entry.compressionMethod);
+    crc32s.push_back(entry.crc32);
+    modified.push_back(entry.modified);
+    localHeaderOffsets.push_back(entry.localHeaderOffset);
+}
+
+uint64_t EntryTable::get(Column column, long row)
+{
+    switch (column)
+    {
+        case COL_ROW:                   return row;
+        case COL_NAME:                  return nameIds[row];
+        case COL_COMPRESSED_SIZE:       return compressedSizes[row];
+        case COL_UNCOMPRESSED_SIZE:     return uncompressedSizes[row];
+        case COL_COMPRESSION_METHOD:    return compressionMethods[row];
+        case COL_CRC32:                 return crc32s[row];
+        case COL_MODIFIED:              return modified[row];
+        case COL_LOCAL_HEADER_OFFSET:   return localHeaderOffsets[row];
+    }
+    return 0;
+}
+
+vector<uint32_t> EntryTable::sort(Column column, bool descending, const vector<uint32_t> *rows)
+{
+    if (column == COL_NAME && nameRanks.size() != nameOffsets.size())
+    { rankNames(); }
+
+    // Names sort by rank, so every column is sorted as integers. Flipping the bits reverses the order of the
+    // values but not of the rows breaking ties.
+    long rowCnt = (rows != NULL) ? rows->size() : size();
+    vector<pair<uint64_t, uint32_t> > keys(rowCnt);
+    for (long idx = 0; idx < rowCnt; idx++)
+    {
+        uint32_t row = (rows != NULL) ? (*rows)[idx] : idx;
+        uint64_t key = (column == COL_NAME) ? nameRanks[nameIds[row]] : get(column, row);
+        keys[idx] = make_pair(descending ? ~key : key, row);
+    }
+
+    parallelSort(keys, [](const pair<uint64_t, uint32_t>& a, const pair<uint64_t, uint32_t>& b) { return a < b; }, chunkCnt(rowCnt));
+
+    vector<uint32_t> out(rowCnt);
+    for (long idx = 0; idx < rowCnt; idx++)
+    {
+        out[idx] = keys[idx].second;
+    }
+    return out;
+}
+
+vector<uint32_t> EntryTable::filterGlob(const char *glob, const vector<uint32_t> *rows)
+{
+    return filterRows(rows, [this, glob](uint32_t row, long chunk) { return fnmatch(glob, getName(row), 0) == 0; });
+}
+
+bool EntryTable::filterRegex(const char *pattern, vector<uint32_t>& out, const vector<uint32_t> *rows)
+{
+    // glibc serializes regexec() calls on the same regex_t, so each chunk gets its own
+    long rowCnt = (rows != NULL) ? rows->size() : size();
+    vector<regex_t> compiled(max(chunkCnt(rowCnt), 1L));
+    for (size_t idx = 0; idx < compiled.size(); idx++)
+    {
+        if (regcomp(&compiled[idx], pattern, REG_EXTENDED | REG_NOSUB) != 0)
+        {
+            for (size_t freedIdx = 0; freedIdx < idx; freedIdx++)
+            {
+                regfree(&compiled[freedIdx]);
+            }
+            return false;
+        }
+    }
+
+    out = filterRows(rows, [this, &compiled](uint32_t row, long chunk) { return regexec(&compiled[chunk], getName(row), 0, NULL, 0) == 0; });
+
+    for (size_t idx = 0; idx < compiled.size(); idx++)
+    {
+        regfree(&compiled[idx]);
+    }
+    return true;
+}
+
+vector<uint32_t> EntryTable::filterRange(Column column, uint64_t min, uint64_t max, const vector<uint32_t> *rows)
+{
+    return filterRows(rows, [this, column, min, max](uint32_t row, long chunk) {
+        uint64_t value = get(column, row);
+        return value >= min && value <= max;
+    });
+}
+
+uint32_t EntryTable::intern(const string& name)
+{
+    // Added to the pool to be looked up, and taken back out if it was there already
+    uint32_t nameId = nameOffsets.size();
+    nameOffsets.push_back(namePool.size());
+    namePool.append(name.c_str(), name.size() + 1);
+
+    pair<unordered_set<uint32_t, NameHash, NameEqual>::iterator, bool> inserted = nameIdsByName.insert(nameId);
+    if (inserted.second)
+    { return nameId; }
+
+    namePool.resize(nameOffsets.back());
+    nameOffsets.pop_back();
+    return *inserted.first;
+}
+
+void EntryTable::rankNames()
+{
+    vector<uint32_t> sorted(nameOffsets.size());
+    for (size_t nameId = 0; nameId < sorted.size(); nameId++)
+    {
+        sorted[nameId] = nameId;
+    }
+
+    const char *pool = namePool.data();
+    const uint32_t *offsets = nameOffsets.data();
+    parallelSort(sorted, [pool, offsets](uint32_t a, uint32_t b) { return strcmp(pool + offsets[a], pool + offsets[b]) < 0; }, chunkCnt(sorted.size()));
+
+    nameRanks.resize(sorted.size());
+    for (size_t rank = 0; rank < sorted.size(); rank++)
+    {
+        nameRanks[sorted[rank]] = rank;
+    }
+}
+
+long EntryTable::chunkCnt(long rowCnt)
+{
+    return max(min((long)threadCnt, rowCnt / MIN_CHUNK_ROWS), 1L);
+}
+
+// Checks each chunk of rows on a worker of its own, then joins the matches up in order
+vector<uint32_t> EntryTable::filterRows(const vector<uint32_t> *rows, function<bool(uint32_t row, long chunk)> matches)
+{
+    long rowCnt = (rows != NULL) ? rows->size() : size();
+    long chunks = chunkCnt(rowCnt);
+    vector<vector<uint32_t> > found(chunks);
+
+    auto filterChunk = [rows, rowCnt, chunks, &matches, &found](long chunk) {
+        for (long idx = rowCnt * chunk / chunks; idx < rowCnt * (chunk + 1) / chunks; idx++)
+        {
+            uint32_t row = (rows != NULL) ? (*rows)[idx] : idx;
+            if (matches(row, chunk))
+            { found[chunk].push_back(row); }
+        }
+    };
+
+    if (chunks == 1)
+    {
+        filterChunk(0);
+        return found[0];
+    }
+
+    ThreadPool pool(chunks);
+    for (long chunk = 0; chunk < chunks; chunk++)
+    {
+        pool.submit([&filterChunk, chunk]() { filterChunk(chunk); });
+    }
+    pool.wait();
+
+    vector<uint32_t> out;
+    for (long chunk = 0; chunk < chunks; chunk++)
+    {
+        out.insert(out.end(), found[chunk].begin(), found[chunk].end());
+    }
+    return out;
+}
@@ -0,0 +1,95 @@
+#ifndef BINVIEW_ENTRY_TABLE
+#define BINVIEW_ENTRY_TABLE
+
+#include <inttypes.h>
+
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "hierarchy.h"
+
+using namespace std;
+
+/* The central directory of one zip archive as columns, one row per "Central Directory File Header" node.
+ *
+ * Each decoded field is an array indexed by row, in file order. Names are interned: each distinct name is stored
+ * once in a pool and rows hold its id. Sorting and filtering read only the columns, never the tree, and are split
+ * across threadCnt workers (0 means one per core) for large tables. They return row numbers, which getHeader() maps
+ * back to the nodes.
+ *
+ * Filled by parse() as it links each header in; see parse(FILE*, EntryTable*).
+ */
+class EntryTable
+{
+public:
+    enum Column
+    {
+        COL_ROW,                // File order
+        COL_NAME,
+        COL_COMPRESSED_SIZE,
+        COL_UNCOMPRESSED_SIZE,
+        COL_COMPRESSION_METHOD,
+        COL_CRC32,
+        COL_MODIFIED,           // MS-DOS date in the high 16 bits, time in the low 16
+        COL_LOCAL_HEADER_OFFSET
+    };
+
+    EntryTable(int threadCnt = 0);
+
+    // Appends the row for a central directory file header, which must be in a tree with a data node
+    void add(Node *header);
+
+    long size() { return headers.size(); }
+
+    Node *getHeader(long row) { return headers[row]; }
+    const char *getName(long row) { return namePool.data() + nameOffsets[nameIds[row]]; }
+    uint64_t get(Column column, long row);     // For COL_NAME, the id of the name: equal names, equal ids
+
+    // Returns rows (all of them if NULL) ordered by column. Equal values keep file order.
+    vector<uint32_t> sort(Column column, bool descending = false, const vector<uint32_t> *rows = NULL);
+
+    // Return the rows (all of them if NULL) whose name matches, keeping their order
+    vector<uint32_t> filterGlob(const char *glob, const vector<uint32_t> *rows = NULL);
+    bool filterRegex(const char *pattern, vector<uint32_t>& out, const vector<uint32_t> *rows = NULL);    // Extended POSIX syntax. False if it does not compile.
+
+    // Returns the rows (all of them if NULL) whose value of column is within [min, max], keeping their order
+    vector<uint32_t> filterRange(Column column, uint64_t min, uint64_t max, const vector<uint32_t> *rows = NULL);
+
+private:
+    // Hashes and compares name ids by the names they stand for
+    struct NameHash
+    {
+        const EntryTable *table;
+        size_t operator()(uint32_t nameId) const;
+    };
+    struct NameEqual
+    {
+        const EntryTable *table;
+        bool operator()(uint32_t a, uint32_t b) const;
+    };
+
+    int threadCnt;
+
+    vector<Node*> headers;
+    vector<uint32_t> nameIds;
+    vector<uint64_t> compressedSizes;
+    vector<uint64_t> uncompressedSizes;
+    vector<uint16_t> compressionMethods;
+    vector<uint32_t> crc32s;
+    vector<uint32_t> modified;
+    vector<uint64_t> localHeaderOffsets;
+
+    string namePool;                // NUL-terminated names
+    vector<uint32_t> nameOffsets;   // By name id
+    unordered_set<uint32_t, NameHash, NameEqual> nameIdsByName;
+    vector<uint32_t> nameRanks;     // By name id: its place in sorted order. Built on first sort by name.
+
+    uint32_t intern(const string& name);
+    void rankNames();
+    long chunkCnt(long rowCnt);
+    vector<uint32_t> filterRows(const vector<uint32_t> *rows, function<bool(uint32_t row, long chunk)> matches);
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "extract.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "threadPool.h"
+#include "zipEntry.h"
+
+using namespace std;
+
+static const long CHUNK_SZ = 256 * 1024;
+
+// Rejects absolute paths and '..' components so an entry cannot be written outside outDir
+static bool isSafeEntryName(const string& name)
+{
+    if (name.empty() || name[0] == '/')
+    { return false; }
+
+    size_t start = 0;
+    while (start <= name.size())
+    {
+        size_t end = name.find('/', start);
+        if (end == string::npos)
+        { end = name.size(); }
+
+        if (name.compare(start, end - start, "..") == 0)
+        { return false; }
+
+        start = end + 1;
+    }
+    return true;
+}
+
+// Creates every directory leading up to the last '/' in path
+static bool makeParentDirs(const string& path)
+{
+    for (size_t sep = path.find('/', 1); sep != string::npos; sep = path.find('/', sep + 1))
+    {
+        string dir = path.substr(0, sep);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+        { return false; }
+    }
+    return true;
+}
+
+static bool writeAll(int outFd, const byte* buffer, long len)
+{
+    while (len > 0)
+    {
+        ssize_t written = write(outFd, buffer, len);
+        if (written <= 0)
+        { return false; }
+
+        buffer += written;
+        len -= written;
+    }
+    return true;
+}
+
+// Copies without passing the data through user space where the kernel allows it
+static bool copyStored(int inFd, long offset, uint64_t len, int outFd)
+{
+    uint64_t remaining = len;
+
+    loff_t inOffset = offset;
+    while (remaining > 0)
+    {
+        ssize_t copied = copy_file_range(inFd, &inOffset, outFd, NULL, remaining, 0);
+        if (copied <= 0)
+        { break; }  // Unsupported here (e.g. across file systems); fall back to sendfile
+        remaining -= copied;
+    }
+
+    off_t sendOffset = inOffset;
+    while (remaining > 0)
+    {
+        ssize_t sent = sendfile(outFd, inFd, &sendOffset, remaining);
+        if (sent <= 0)
+        { break; }
+        remaining -= sent;
+    }
+
+    if (remaining == 0)
+    { return true; }
+
+    byte* buffer = (byte*)malloc(CHUNK_SZ);
+    long readOffset = sendOffset;
+    while (remaining > 0)
+    {
+        ssize_t readCnt = pread(inFd, buffer, remaining < CHUNK_SZ ? remaining : CHUNK_SZ, readOffset);
+        if (readCnt <= 0 || ! writeAll(outFd, buffer, readCnt))
+        { break; }
+
+        readOffset += readCnt;
+        remaining -= readCnt;
+    }
+    free(buffer);
+
+    return remaining == 0;
+}
+
+static const char* extractEntry(int inFd, const ZipEntry& entry, const string& outDir)
+{
+    if (! isSafeEntryName(entry.name))
+    { return "unsafe path"; }
+
+    string path = outDir + "/" + entry.name;
+    if (! makeParentDirs(path))
+    { return strerror(errno); }
+
+    // Directory entries have a trailing '/' and no data
+    if (path[path.size() - 1] == '/')
+    { return NULL; }
+
+    if (entry.localHeader == NULL)
+    { return "no local file header"; }
+
+    if (! entry.canDecompress())
+    { return "unsupported compression method"; }
+
+    int outFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFd < 0)
+    { return strerror(errno); }
+
+    bool ok;
+    if (entry.compressionMethod == ZipEntry::METHOD_STORED)
+    {
+        ok = copyStored(inFd, entry.dataOffset, entry.compressedSize, outFd);
+    } else {
+        ok = readEntryData(inFd, entry, [outFd](const byte* buffer, long len) {
+            return writeAll(outFd, buffer, len);
+        });
+    }
+
+    close(outFd);
+
+    return ok ? NULL : "corrupt or truncated data";
+}
+
+static bool isLarger(const ZipEntry* left, const ZipEntry* right)
+{
+    return left->compressedSize > right->compressedSize;
+}
+
+long extractArchive(FILE *fp, Node *root, const char *outDir, int threadCnt, ExtractStats *stats)
+{
+    vector<ZipEntry> entries = findZipEntries(root);
+
+    // Start the largest entries first so a big entry is not left running alone at the end
+    vector<const ZipEntry*> schedule;
+    for (vector<ZipEntry>::iterator iter = entries.begin(); iter < entries.end(); iter++)
+    {
+        schedule.push_back(&(*iter));
+    }
+    stable_sort(schedule.begin(), schedule.end(), isLarger);
+
+    // Workers read through pread() on the descriptor, which leaves fp's seek position untouched
+    int inFd = fileno(fp);
+    string outDirStr = outDir;
+
+    atomic<long> failedCnt(0);
+    atomic<uint64_t> bytesWritten(0);
+    mutex reportLock;
+
+    ThreadPool pool(threadCnt);
+    for (vector<const ZipEntry*>::iterator iter = schedule.begin(); iter < schedule.end(); iter++)
+    {
+        const ZipEntry* entry = *iter;
+        pool.submit([=, &failedCnt, &bytesWritten, &reportLock]() {
+            const char* error = extractEntry(inFd, *entry, outDirStr);
+            if (error != NULL)
+            {
+                failedCnt++;
+                unique_lock<mutex> guard(reportLock);
+                fprintf(stderr, "%s: %s\n", entry->name.c_str(), error);
+                return;
+            }
+            bytesWritten += entry->uncompressedSize;
+        });
+    }
+    pool.wait();
+
+    if (stats != NULL)
+    {
+        stats->entryCnt = entries.size();
+        stats->failedCnt = failedCnt;
+        stats->bytesWritten = bytesWritten;
+    }
+
+    return failedCnt;
+}
@@ -0,0 +1,25 @@
+#ifndef BINVIEW_EXTRACT
+#define BINVIEW_EXTRACT
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "hierarchy.h"
+
+struct ExtractStats
+{
+    long entryCnt;
+    long failedCnt;
+    uint64_t bytesWritten;
+};
+
+/*
+ * Writes every entry listed in the central directory of the parsed zip archive under outDir, creating directories as
+ * needed.
+ * Entries are extracted concurrently on threadCnt workers (0 means one per core), largest first.
+ * Stored entries are copied in-kernel; deflated entries are inflated with zlib.
+ * Returns the number of entries that could not be extracted. Reasons are reported on stderr.
+ */
+long extractArchive(FILE *fp, Node *root, const char *outDir, int threadCnt, ExtractStats *stats = NULL);
+
+#endif
@@ -0,0 +1,305 @@
+#include "formatCache.h"
+
+FormatCache::FormatCache(Node* root, size_t maxBytes) : root(root), graph(NULL), size(0), maxBytes(maxBytes) {}
+
+FormatCache::~FormatCache()
+{
+    delete graph;
+}
+
+// Counts the bookkeeping alongside the characters, so many short values still count against the cap
+size_t FormatCache::valueSize(const string& text)
+{
+    return sizeof(FormattedValue) + sizeof(Node*) * 4 + text.size();
+}
+
+size_t FormatCache::valueSize(const Value& value)
+{
+    return sizeof(Value) + value.flags.size() * sizeof(uint32_t) + value.text.size();
+}
+
+bool FormatCache::lookup(Node* node, Locale locale, long maxLen, string& out)
+{
+    unique_lock<mutex> guard(lock);
+
+    unordered_map<Node*, NodeValues>::iterator found = cache.find(node);
+    if (found == cache.end())
+    { return false; }
+
+    vector<FormattedValue>& values = found->second.values;
+    for (vector<FormattedValue>::iterator iter = values.begin(); iter < values.end(); iter++)
+    {
+        if (iter->locale == locale && iter->maxLen == maxLen)
+        {
+            lru.splice(lru.begin(), lru, found->second.lruPos);
+            out = iter->text;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FormatCache::lookupDecoded(Node* node, Value& out)
+{
+    unique_lock<mutex> guard(lock);
+
+    unordered_map<Node*, NodeValues>::iterator found = cache.find(node);
+    if (found == cache.end() || !found->second.hasDecoded)
+    { return false; }
+
+    lru.splice(lru.begin(), lru, found->second.lruPos);
+    out = found->second.decoded;
+    return true;
+}
+
+// Caller holds lock. Returns the node's entry, created if needed and marked most recently used.
+FormatCache::NodeValues& FormatCache::touch(Node* node)
+{
+    unordered_map<Node*, NodeValues>::iterator found = cache.find(node);
+    if (found == cache.end())
+    {
+        lru.push_front(node);
+        found = cache.insert(make_pair(node, NodeValues())).first;
+        found->second.lruPos = lru.begin();
+    } else {
+        lru.splice(lru.begin(), lru, found->second.lruPos);
+    }
+    return found->second;
+}
+
+void FormatCache::store(Node* node, Locale locale, long maxLen, const string& text)
+{
+    unique_lock<mutex> guard(lock);
+
+    // Another thread may have formatted the same value meanwhile
+    vector<FormattedValue>& values = touch(node).values;
+    for (vector<FormattedValue>::iterator iter = values.begin(); iter < values.end(); iter++)
+    {
+        if (iter->locale == locale && iter->maxLen == maxLen)
+        { return; }
+    }
+
+    FormattedValue value = {locale, maxLen, text};
+    values.push_back(value);
+    size += valueSize(text);
+
+    // Never evict the node just stored
+    while (size > maxBytes && lru.back() != node)
+    {
+        erase(lru.back());
+    }
+}
+
+void FormatCache::storeDecoded(Node* node, const Value& value)
+{
+    unique_lock<mutex> guard(lock);
+
+    NodeValues& nodeValues = touch(node);
+    if (nodeValues.hasDecoded)
+    { return; }
+
+    nodeValues.hasDecoded = true;
+    nodeValues.decoded = value;
+    size += valueSize(value);
+
+    while (size > maxBytes && lru.back() != node)
+    {
+        erase(lru.back());
+    }
+}
+
+// Caller holds lock
+void FormatCache::erase(Node* node)
+{
+    unordered_map<Node*, NodeValues>::iterator found = cache.find(node);
+    if (found == cache.end())
+    { return; }
+
+    vector<FormattedValue>& values = found->second.values;
+    for (vector<FormattedValue>::iterator iter = values.begin(); iter < values.end(); iter++)
+    {
+        size -= valueSize(iter->text);
+    }
+    if (found->second.hasDecoded)
+    { size -= valueSize(found->second.decoded); }
+
+    lru.erase(found->second.lruPos);
+    cache.erase(found);
+}
+
+void FormatCache::collectSubtree(Node* node, vector<Node*>& out)
+{
+    out.push_back(node);
+
+    for (Node* child = node->firstChild; child != NULL; child = child->nextSibling)
+    {
+        collectSubtree(child, out);
+    }
+}
+
+void FormatCache::treeChanged()
+{
+    unique_lock<mutex> guard(lock);
+
+    delete graph;
+    graph = NULL;
+}
+
+// Caller holds lock
+DependencyGraph* FormatCache::getGraph()
+{
+    if (graph == NULL)
+    { graph = new DependencyGraph(root); }
+
+    return graph;
+}
+
+string FormatCache::format(Node* node, Locale locale, long maxLen)
+{
+    string text;
+    if (lookup(node, locale, maxLen, text))
+    { return text; }
+
+    if (node->pInterpretation != NULL)
+    {
+        IByteIterator* itr = getDataNode(node)->accessor->iterator();
+        text = node->pInterpretation->format(*itr, locale, maxLen);
+        delete itr;
+    }
+
+    store(node, locale, maxLen, text);
+    return text;
+}
+
+Value FormatCache::decode(Node* node)
+{
+    Value value;
+    if (lookupDecoded(node, value))
+    { return value; }
+
+    IByteIterator* itr = getDataNode(node)->accessor->iterator();
+    if (node->pInterpretation != NULL)
+    { value = node->pInterpretation->decode(*itr); }
+    else
+    { value = Value::ofBytes(0, itr->getSize()); }
+    delete itr;
+
+    storeDecoded(node, value);
+    return value;
+}
+
+void FormatCache::invalidate(Node* node)
+{
+    unique_lock<mutex> guard(lock);
+
+    vector<Node*> changed;
+    for (Node* ancestor = node->parent; ancestor != NULL; ancestor = ancestor->parent)
+    {
+        changed.push_back(ancestor);
+    }
+    collectSubtree(node, changed);
+
+    vector<Node*> affected = getGraph()->affectedBy(changed);
+    for (vector<Node*>::iterator iter = affected.begin(); iter < affected.end(); iter++)
+    {
+        erase(*iter);
+    }
+}
+
+vector<Node*> FormatCache::invalidateRange(long offset, long length)
+{
+    vector<Node*> affected;
+
+    // What each affected node had cached, so the same values can be recomputed
+    vector<vector<pair<Locale, long> > > formattedKeys;
+    vector<bool> hadDecoded;
+    {
+        unique_lock<mutex> guard(lock);
+
+        DependencyGraph* graph = getGraph();
+        affected = graph->affectedBy(graph->findOverlapping(offset, length));
+
+        for (vector<Node*>::iterator iter = affected.begin(); iter < affected.end(); iter++)
+        {
+            vector<pair<Locale, long> > keys;
+            bool decoded = false;
+
+            unordered_map<Node*, NodeValues>::iterator found = cache.find(*iter);
+            if (found != cache.end())
+            {
+                vector<FormattedValue>& values = found->second.values;
+                for (vector<FormattedValue>::iterator value = values.begin(); value < values.end(); value++)
+                {
+                    keys.push_back(make_pair(value->locale, value->maxLen));
+                }
+                decoded = found->second.hasDecoded;
+            }
+
+            formattedKeys.push_back(keys);
+            hadDecoded.push_back(decoded);
+            erase(*iter);
+        }
+    }
+
+    // Dependencies come first, so each node is recomputed from fresh values
+    for (size_t nodeIdx = 0; nodeIdx < affected.size(); nodeIdx++)
+    {
+        if (hadDecoded[nodeIdx])
+        { decode(affected[nodeIdx]); }
+
+        vector<pair<Locale, long> >& keys = formattedKeys[nodeIdx];
+        for (vector<pair<Locale, long> >::iterator key = keys.begin(); key < keys.end(); key++)
+        {
+            format(affected[nodeIdx], key->first, key->second);
+        }
+    }
+
+    return affected;
+}
+
+void FormatCache::invalidateAll()
+{
+    unique_lock<mutex> guard(lock);
+
+    cache.clear();
+    lru.clear();
+    size = 0;
+}
+
+size_t FormatCache::getSize()
+{
+    unique_lock<mutex> guard(lock);
+    return size;
+}
+
+FormatCache* getFormatCache(Node* root)
+{
+    FormatCache* cache = root->formatCache;
+    if (cache != NULL)
+    { return cache; }
+
+    // Threads formatting the same new tree may race to make it. The first published wins; the others drop theirs.
+    FormatCache* made = new FormatCache(root);
+    if (root->formatCache.compare_exchange_strong(cache, made))
+    { return made; }
+
+    delete made;
+    return cache;
+}
+
+static Node* rootOf(Node* node)
+{
+    while (node->parent != NULL)
+    { node = node->parent; }
+    return node;
+}
+
+string formatNode(Node* node, Locale locale, long maxLen)
+{
+    return getFormatCache(rootOf(node))->format(node, locale, maxLen);
+}
+
+Value decodeNode(Node* node)
+{
+    return getFormatCache(rootOf(node))->decode(node);
+}
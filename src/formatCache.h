@@ -0,0 +1,103 @@
+#ifndef BINVIEW_FORMAT_CACHE
+#define BINVIEW_FORMAT_CACHE
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hierarchy.h"
+#include "interpretation.h"
+#include "dependencyGraph.h"
+
+using namespace std;
+
+/* Memoizes Interpretation::format and Interpretation::decode results for the nodes of one tree.
+ *
+ * Formatted values are keyed by node, locale and length budget, and filled on first request. When the
+ * cached values exceed maxBytes, the least recently used nodes are evicted.
+ *
+ * Safe to use from several threads; formatting itself runs outside the cache's lock.
+ */
+class FormatCache
+{
+public:
+    static const size_t DEFAULT_MAX_BYTES = 16 * 1024 * 1024;
+
+    FormatCache(Node* root, size_t maxBytes = DEFAULT_MAX_BYTES);
+    ~FormatCache();
+
+    // Returns the node's formatted value, formatting it on a miss. Nodes without an interpretation format as "".
+    string format(Node* node, Locale locale, long maxLen = Interpretation::UNBOUNDED);
+
+    // Returns the node's decoded value. Nodes without an interpretation decode to their range of bytes.
+    Value decode(Node* node);
+
+    // Sets out to the node's formatted value if it is cached, without ever formatting it
+    bool lookup(Node* node, Locale locale, long maxLen, string& out);
+
+    // Call when the node's bytes change. Drops the values of the node, its ancestors and its descendants,
+    // all of which cover the changed bytes, and of every node whose interpretation reads one of those.
+    void invalidate(Node* node);
+
+    // Call when bytes [offset, offset + length) of the file change. Drops the values of the nodes covering them
+    // and of the nodes computed from those, then recomputes the values that were cached, dependencies first.
+    // Returns the affected nodes in that order.
+    vector<Node*> invalidateRange(long offset, long length);
+
+    void invalidateAll();
+
+    // Call after nodes are added to or removed from the tree, so invalidation sees them
+    void treeChanged();
+
+    size_t getSize();   // Approximate bytes held
+
+private:
+    struct FormattedValue
+    {
+        Locale locale;
+        long maxLen;
+        string text;
+    };
+
+    struct NodeValues
+    {
+        vector<FormattedValue> values;
+        bool hasDecoded;
+        Value decoded;
+        list<Node*>::iterator lruPos;
+
+        NodeValues() : hasDecoded(false) {}
+    };
+
+    mutex lock;
+    Node* root;
+    DependencyGraph* graph;     // Built on first use, and again after the tree changes
+    unordered_map<Node*, NodeValues> cache;
+    list<Node*> lru;    // Most recently used at the front
+    size_t size;
+    size_t maxBytes;
+
+    void store(Node* node, Locale locale, long maxLen, const string& text);
+    bool lookupDecoded(Node* node, Value& out);
+    void storeDecoded(Node* node, const Value& value);
+    NodeValues& touch(Node* node);
+    void erase(Node* node);
+    void collectSubtree(Node* node, vector<Node*>& out);
+    DependencyGraph* getGraph();
+    static size_t valueSize(const string& text);
+    static size_t valueSize(const Value& value);
+};
+
+// Returns the cache shared by everything formatting nodes of root's tree, creating it on first use. Takes no lock once
+// made, so threads formatting different trees do not wait on each other.
+FormatCache* getFormatCache(Node* root);
+
+// Formats node through its tree's cache
+string formatNode(Node* node, Locale locale, long maxLen = Interpretation::UNBOUNDED);
+
+// Decodes node through its tree's cache
+Value decodeNode(Node* node);
+
+#endif
@@ -0,0 +1,117 @@
+#include "hexEncode.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BINVIEW_HEX_AVX2
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BINVIEW_HEX_SSE2
+#endif
+
+// pairs[b] holds the two digits of byte b
+struct HexPairs
+{
+    char pairs[256][2];
+
+    HexPairs()
+    {
+        static const char digits[] = "0123456789ABCDEF";
+        for (int value = 0; value < 256; value++)
+        {
+            pairs[value][0] = digits[value >> 4];
+            pairs[value][1] = digits[value & 0xF];
+        }
+    }
+};
+
+static void hexEncodeScalar(const byte* src, size_t len, char* dst)
+{
+    static const HexPairs table;
+
+    for (size_t byteIdx = 0; byteIdx < len; byteIdx++)
+    {
+        memcpy(dst + byteIdx * 2, table.pairs[src[byteIdx]], 2);
+    }
+}
+
+#ifdef BINVIEW_HEX_SSE2
+// Maps each nibble n to '0' + n, plus 7 more for 'A'..'F'
+static inline __m128i nibblesToHex(__m128i nibbles)
+{
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+// 16 bytes in, 32 digits out per iteration. Returns the number of bytes encoded.
+static size_t hexEncodeSse2(const byte* src, size_t len, char* dst)
+{
+    const __m128i lowMask = _mm_set1_epi8(0xF);
+
+    size_t byteIdx = 0;
+    for (; byteIdx + 16 <= len; byteIdx += 16)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + byteIdx));
+        __m128i high = nibblesToHex(_mm_and_si128(_mm_srli_epi16(in, 4), lowMask));
+        __m128i low = nibblesToHex(_mm_and_si128(in, lowMask));
+
+        // Interleave so each byte's high digit precedes its low digit
+        _mm_storeu_si128((__m128i*)(dst + byteIdx * 2), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i*)(dst + byteIdx * 2 + 16), _mm_unpackhi_epi8(high, low));
+    }
+    return byteIdx;
+}
+#endif
+
+#ifdef BINVIEW_HEX_AVX2
+// 32 bytes in, 64 digits out per iteration. Returns the number of bytes encoded.
+__attribute__((target("avx2")))
+static size_t hexEncodeAvx2(const byte* src, size_t len, char* dst)
+{
+    const __m256i digits = _mm256_setr_epi8(
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m256i lowMask = _mm256_set1_epi8(0xF);
+
+    size_t byteIdx = 0;
+    for (; byteIdx + 32 <= len; byteIdx += 32)
+    {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(src + byteIdx));
+        __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(in, 4), lowMask));
+        __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(in, lowMask));
+
+        // Unpacking works within each 128-bit lane, so the halves come out as bytes 0-7 | 16-23 and 8-15 | 24-31
+        __m256i first = _mm256_unpacklo_epi8(high, low);
+        __m256i second = _mm256_unpackhi_epi8(high, low);
+
+        _mm256_storeu_si256((__m256i*)(dst + byteIdx * 2), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i*)(dst + byteIdx * 2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return byteIdx;
+}
+
+static bool hasAvx2()
+{
+    static bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+void hexEncode(const byte* src, size_t len, char* dst)
+{
+    size_t doneLen = 0;
+
+#ifdef BINVIEW_HEX_AVX2
+    if (len >= 32 && hasAvx2())
+    { doneLen = hexEncodeAvx2(src, len, dst); }
+#endif
+
+#ifdef BINVIEW_HEX_SSE2
+    doneLen += hexEncodeSse2(src + doneLen, len - doneLen, dst + doneLen * 2);
+#endif
+
+    hexEncodeScalar(src + doneLen, len - doneLen, dst + doneLen * 2);
+}
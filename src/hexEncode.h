@@ -0,0 +1,14 @@
+#ifndef BINVIEW_HEX_ENCODE
+#define BINVIEW_HEX_ENCODE
+
+#include <stddef.h>
+
+#include "byteIterator.h"
+
+/*
+ * Writes two uppercase hex digits per byte of src into dst, which must hold 2 * len chars.
+ * No terminator is written. Uses AVX2 or SSE2 when available and a lookup table otherwise.
+ */
+void hexEncode(const byte* src, size_t len, char* dst);
+
+#endif
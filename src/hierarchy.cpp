@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "hierarchy.h"
+#include "formatCache.h"
 
 #include <stdio.h>
 
@@ -14,6 +15,7 @@ void Node::init(const char *description, Segment *segments, int segmentCnt, Inte
 {
     this->description = (char*)malloc(strlen(description) + 1);
     strcpy(this->description, description);
+    this->annotation = NULL;
 
     if (segmentCnt)
     {
@@ -25,8 +27,10 @@ void Node::init(const char *description, Segment *segments, int segmentCnt, Inte
         this->segments = NULL;
     }
 
-    printf("%s: %X\n", description,pInterpretation);
+    this->baseOffset = 0;
+
     this->pInterpretation = pInterpretation;
+    this->ownsInterpretation = false;
     
     this->firstChild = NULL;
     this->lastChild = NULL;
@@ -35,6 +39,17 @@ void Node::init(const char *description, Segment *segments, int segmentCnt, Inte
 
     this->nextSibling = NULL;
     this->prevSibling = NULL;
+
+    this->formatCache = NULL;
+}
+
+void placeNode(Node *node, long baseOffset)
+{
+    node->baseOffset = baseOffset;
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling)
+    {
+        placeNode(child, absoluteOffset(node));
+    }
 }
 
 void addChildNode(Node *parent, Node *child)
@@ -44,19 +59,70 @@ void addChildNode(Node *parent, Node *child)
     if (parent->firstChild == NULL)
     {
         parent->firstChild = parent->lastChild = child;
+    } else {
+        parent->lastChild->nextSibling = child;
+        child->prevSibling = parent->lastChild;
+        parent->lastChild = child;
+    }
+
+    // Records are read into a staging node and moved, so a child may bring a subtree of its own
+    placeNode(child, absoluteOffset(parent));
+}
+
+void annotateNode(Node *node, const char *text)
+{
+    if (node->annotation == NULL)
+    {
+        node->annotation = (char*)malloc(strlen(text) + 1);
+        strcpy(node->annotation, text);
         return;
     }
 
-    parent->lastChild->nextSibling = child;
-    child->prevSibling = parent->lastChild;
-    parent->lastChild = child;
+    size_t prevLen = strlen(node->annotation);
+    node->annotation = (char*)realloc(node->annotation, prevLen + 2 + strlen(text) + 1);
+    strcpy(node->annotation + prevLen, "; ");
+    strcpy(node->annotation + prevLen + 2, text);
+}
+
+Node *findChild(const Node *parent, const char *description)
+{
+    for (Node *child = parent->firstChild; child != NULL; child = child->nextSibling)
+    {
+        if (strcmp(child->description, description) == 0)
+        { return child; }
+    }
+    return NULL;
+}
+
+long absoluteOffset(const Node *node)
+{
+    return node->baseOffset + node->segments[0].offset;
+}
+
+Segment absoluteSegment(const Node *node, int segIdx)
+{
+    Segment segment = {node->baseOffset + node->segments[segIdx].offset, node->segments[segIdx].length};
+    return segment;
 }
 
 void deleteNode(Node *node)
 {
     free(node->description);
+    if (node->annotation)
+    { free(node->annotation); }
     if (node->segments)
     { free(node->segments); }
+    FormatCache* formatCache = node->formatCache;
+    if (formatCache)
+    { delete formatCache; }
+    if (node->ownsInterpretation)
+    { delete node->pInterpretation; }
+    DataNode* dataNode = node->dataNode;
+    if (dataNode)
+    {
+        delete dataNode->accessor;
+        delete dataNode;
+    }
 
     Node* nextChild = node->firstChild;
     Node* thisChild;
@@ -67,18 +133,30 @@ void deleteNode(Node *node)
         deleteNode(thisChild);
     }
 
-    free(node);
+    delete node;
+}
+
+DataNode::DataNode(Node* node, IByteAccessor* accessor) : node(node), accessor(accessor)
+{
+    node->dataNode = this;
 }
 
-IByteAccessor* DataNode::getAccessorForChildNode(Node* node)
+// An accessor for node's segments, cut from that of ancestor. Offsets into an accessor are taken as offsets into the
+// file from the start of its node, which holds for nodes of one segment, the only kind the parser makes.
+static IByteAccessor* accessorFrom(DataNode* ancestor, Node* node)
 {
+    long ancestorOffset = absoluteOffset(ancestor->node);
     if (node->segmentCnt == 1)
-    { return accessor->subset(node->segments[0].offset, node->segments[0].length); }
+    {
+        Segment segment = absoluteSegment(node, 0);
+        return ancestor->accessor->subset(segment.offset - ancestorOffset, segment.length);
+    }
 
     IByteAccessor** subsetArr = (IByteAccessor**)malloc(sizeof(IByteAccessor*) * node->segmentCnt);
     for (int segIdx = 0; segIdx < node->segmentCnt; segIdx++)
     {
-        subsetArr[segIdx] = accessor->subset(node->segments[segIdx].offset, node->segments[segIdx].length);
+        Segment segment = absoluteSegment(node, segIdx);
+        subsetArr[segIdx] = ancestor->accessor->subset(segment.offset - ancestorOffset, segment.length);
     }
 
     AggAccessor* out = new AggAccessor(subsetArr, node->segmentCnt);
@@ -86,43 +164,26 @@ IByteAccessor* DataNode::getAccessorForChildNode(Node* node)
     return out;
 }
 
-DataNode::DataNode(Node* node, IByteAccessor* accessor) : node(node), accessor(accessor)
-{
-    node->dataNode = this;
-
-    Node* child = node->firstChild;
-    DataNode* prevDataChild = NULL;
-    while (child)
-    {
-        IByteAccessor* childAccessor = getAccessorForChildNode(child);
-        DataNode* dataChild = new DataNode(child, childAccessor);
-
-        if (prevDataChild == NULL)
-        {
-            firstChild = dataChild;
-        } else {
-            dataChild->prevSibling = prevDataChild;
-            prevDataChild->nextSibling = dataChild;
-        }
-        lastChild = dataChild;
-        dataChild->parent = this;
-
-        prevDataChild = dataChild;
-        child = child->nextSibling;
-    }
-}
-
-DataNode* DataNode::findDescendant(Node* node)
+DataNode* getDataNode(Node* node)
 {
-    if (this->node == node)
-    { return this; }
-
-    for (DataNode* child = firstChild; child != NULL; child = child->nextSibling)
-    {
-        DataNode* found = child->findDescendant(node);
-        if (found != NULL)
-        { return found; }
-    }
-    return NULL;
+    DataNode* dataNode = node->dataNode;
+    if (dataNode != NULL)
+    { return dataNode; }
+
+    Node* ancestor = node->parent;
+    while (ancestor != NULL && ancestor->dataNode == NULL)
+    { ancestor = ancestor->parent; }
+    if (ancestor == NULL)
+    { return NULL; }
+
+    // Formatting threads may ask for the same node at once. The first published wins; the others drop theirs.
+    DataNode* made = new DataNode();
+    made->node = node;
+    made->accessor = accessorFrom(ancestor->dataNode, node);
+    if (node->dataNode.compare_exchange_strong(dataNode, made))
+    { return made; }
+
+    delete made->accessor;
+    delete made;
+    return dataNode;
 }
-
@@ -3,6 +3,9 @@
 
 class Node;
 class DataNode;
+class FormatCache;
+
+#include <atomic>
 
 #include "interpretation.h"
 #include "byteAccessor.h"
@@ -67,13 +70,17 @@ class Node
 {
 public:
     char *description;
+    char *annotation;   // Findings attached after parsing (e.g. integrity problems), or NULL
 
-    Segment *segments;
+    Segment *segments;  // Offsets are relative to the start of the parent's first segment
     int segmentCnt;
+    long baseOffset;    // Where the parent's first segment starts in the file, which segments are relative to. Kept
+                        // by addChildNode(), so absolute offsets are never summed up the tree.
 
-    DataNode *dataNode;
+    std::atomic<DataNode*> dataNode;    // Made on first use, so read it through getDataNode()
 
     Interpretation* pInterpretation;
+    bool ownsInterpretation;    // pInterpretation was made for this node alone and is deleted with it
 
     Node *firstChild;
     Node *lastChild;
@@ -83,33 +90,57 @@ public:
     Node *nextSibling;    // Children are a linked list. The first child points to the next.
     Node *prevSibling;
 
+    std::atomic<FormatCache*> formatCache;  // Only set on the root. See getFormatCache().
+
     Node(const char *description, long offset, long length, Interpretation* interpretation);
 private:
     void init(const char *description, Segment *segments, int segmentCnt, Interpretation* interpretation);
 };
 
+/* What a node's bytes are read through.
+ *
+ * Data nodes are made on first use by getDataNode(), so nodes never read cost nothing. Each accessor is cut straight
+ * from that of the nearest ancestor with a data node, at the node's absolute offsets, so the data nodes in between are
+ * never needed. The parser binds the root, and any node standing in for it, explicitly.
+ */
 class DataNode
 {
 public:
     Node* node;
     IByteAccessor* accessor;
 
-    DataNode* firstChild = NULL;
-    DataNode* lastChild = NULL;
-    DataNode* parent = NULL;
-    DataNode* nextSibling = NULL;
-    DataNode* prevSibling = NULL;
-
+    // Binds node to accessor
     DataNode(Node* node, IByteAccessor* accessor);
 
-    DataNode* findDescendant(Node* node);
-
 private:
-    IByteAccessor* getAccessorForChildNode(Node* node);
+    // Unbound, for getDataNode() to publish
+    DataNode() : node(NULL), accessor(NULL) {}
+
+    friend DataNode* getDataNode(Node* node);
 };
 
+// Returns node's data node, making it if needed. NULL if no ancestor has one to make it from.
+DataNode* getDataNode(Node* node);
+
+// Appends child to parent's children, and updates the absolute offsets of child and its descendants
 void addChildNode(Node *parent, Node *child);
 
+// Sets the offset node's segments are relative to and updates its descendants, as if node were under a parent starting
+// at baseOffset. For nodes handled outside of the tree; addChildNode() places the nodes it links in.
+void placeNode(Node *node, long baseOffset);
+
+// Appends text to the node's annotation, separating it from earlier annotations with "; "
+void annotateNode(Node *node, const char *text);
+
+// Returns the first child of parent with the given description, or NULL
+Node *findChild(const Node *parent, const char *description);
+
+// Offset of the node's first segment, relative to the start of the root Node
+long absoluteOffset(const Node *node);
+
+// The node's segment segIdx, with its offset relative to the start of the root Node
+Segment absoluteSegment(const Node *node, int segIdx);
+
 void deleteNode(Node *node);
 
 #endif
@@ -1,39 +1,238 @@
 #include "interpretation.h"
+#include "formatCache.h"
+#include "hexEncode.h"
 
-string AscizInterpretation::format(IByteIterator& data, Locale Locale)
+#include <string.h>
+
+#include <algorithm>
+
+Value::Value() : type(TYPE_NONE), uintValue(0), offset(0), length(0), year(0), month(0), day(0), hour(0), minute(0), second(0) {}
+
+Value Value::ofUInt(uint64_t value)
 {
-    string out = "";
-    while(data.hasNext() && data.next())
-    {
-        out += data.next();
-    }
+    Value out;
+    out.type = TYPE_UINT;
+    out.uintValue = value;
     return out;
 }
 
-string AsciiInterpretation::format(IByteIterator& data, Locale Locale)
+Value Value::ofInt(int64_t value)
 {
-    string out = "";
-    while(data.hasNext())
-    {
-        out += data.next();
-    }
+    Value out;
+    out.type = TYPE_INT;
+    out.intValue = value;
+    return out;
+}
+
+Value Value::ofBytes(long offset, long length)
+{
+    Value out;
+    out.type = TYPE_BYTES;
+    out.offset = offset;
+    out.length = length;
+    return out;
+}
+
+Value Value::ofDate(uint16_t year, uint8_t month, uint8_t day)
+{
+    Value out;
+    out.type = TYPE_DATE;
+    out.year = year;
+    out.month = month;
+    out.day = day;
+    return out;
+}
+
+Value Value::ofTime(uint8_t hour, uint8_t minute, uint8_t second)
+{
+    Value out;
+    out.type = TYPE_TIME;
+    out.hour = hour;
+    out.minute = minute;
+    out.second = second;
+    return out;
+}
+
+Value Value::ofFlags(uint64_t bits, const vector<uint32_t>& flags)
+{
+    Value out;
+    out.type = TYPE_FLAGS;
+    out.uintValue = bits;
+    out.flags = flags;
+    return out;
+}
+
+Value Value::ofText(const string& text)
+{
+    Value out;
+    out.type = TYPE_TEXT;
+    out.text = text;
+    return out;
+}
+
+uint64_t Value::asUInt() const
+{
+    if (type == TYPE_UINT || type == TYPE_INT || type == TYPE_FLAGS)
+    { return uintValue; }
+
+    return 0;
+}
+
+Value Interpretation::decode(IByteIterator& data)
+{
+    return Value::ofBytes(0, data.getSize());
+}
+
+// Marks a value that was cut short, giving the full length of the data behind it. With less room than that,
+// just "..." or as much of it as fits.
+static string truncationSuffix(long totalBytes, long room)
+{
+    string suffix = "... (" + std::to_string(totalBytes) + " bytes)";
+    if ((long)suffix.size() <= room)
+    { return suffix; }
+
+    return string(room < 0 ? 0 : (room < 3 ? room : 3), '.');
+}
+
+// Cuts a composed value down to maxLen characters, marking the cut with "..."
+static string capLength(const string& value, long maxLen)
+{
+    if (maxLen == Interpretation::UNBOUNDED || (long)value.size() <= maxLen)
+    { return value; }
+
+    if (maxLen <= 3)
+    { return string(maxLen < 0 ? 0 : maxLen, '.'); }
+
+    return value.substr(0, maxLen - 3) + "...";
+}
+
+// Reads and decodes a text field, escaping what cannot be shown. Every byte decodes to at least one
+// character, so with a budget only maxLen bytes (plus enough to finish a UTF-8 sequence) are read.
+static string formatText(IByteIterator& data, TextEncoding encoding, bool stopAtNul, long maxLen)
+{
+    long totalLen = data.getSize();
+    long readLen = (maxLen == Interpretation::UNBOUNDED || totalLen <= maxLen + 3) ? totalLen : maxLen + 3;
+
+    vector<byte> bytes(readLen);
+    readLen = data.read(bytes.data(), readLen);
+
+    string out;
+    long decodedLen = decodeText(bytes.data(), readLen, encoding, true, stopAtNul, out);
+
+    bool cut = decodedLen == readLen && readLen < totalLen;
+    if (maxLen == Interpretation::UNBOUNDED || (!cut && (long)out.size() <= maxLen))
+    { return out; }
+
+    string suffix = truncationSuffix(totalLen, maxLen);
+    long keepLen = maxLen - (long)suffix.size();
+
+    // Do not split a multi-byte character
+    while (keepLen > 0 && (out[keepLen] & 0xC0) == 0x80)
+    { keepLen--; }
+
+    out.resize(keepLen);
+    out += suffix;
     return out;
 }
 
-string HexInterpretation::format(IByteIterator& data, Locale Locale)
+// Decodes the whole field, keeping bytes that cannot be shown
+static string decodeTextField(IByteIterator& data, TextEncoding encoding, bool stopAtNul)
+{
+    vector<byte> bytes(data.getSize());
+    long readLen = data.read(bytes.data(), bytes.size());
+
+    string out;
+    decodeText(bytes.data(), readLen, encoding, false, stopAtNul, out);
+    return out;
+}
+
+string AscizInterpretation::format(IByteIterator& data, Locale Locale, long maxLen)
+{
+    return formatText(data, TEXT_ASCII, true, maxLen);
+}
+
+Value AscizInterpretation::decode(IByteIterator& data)
+{
+    return Value::ofText(decodeTextField(data, TEXT_ASCII, true));
+}
+
+string AsciiInterpretation::format(IByteIterator& data, Locale Locale, long maxLen)
+{
+    return formatText(data, TEXT_ASCII, false, maxLen);
+}
+
+Value AsciiInterpretation::decode(IByteIterator& data)
+{
+    return Value::ofText(decodeTextField(data, TEXT_ASCII, false));
+}
+
+TextInterpretation::TextInterpretation(TextEncoding encoding, bool stopAtNul) : flagsNode(NULL), encoding(encoding), stopAtNul(stopAtNul) {}
+
+TextInterpretation::TextInterpretation(Node* flagsNode) : flagsNode(flagsNode), encoding(TEXT_CP437), stopAtNul(false) {}
+
+TextEncoding TextInterpretation::selectEncoding()
+{
+    if (flagsNode == NULL)
+    { return encoding; }
+
+    return (decodeNode(flagsNode).asUInt() & FLAG_UTF8) ? TEXT_UTF8 : TEXT_CP437;
+}
+
+string TextInterpretation::format(IByteIterator& data, Locale locale, long maxLen)
+{
+    return formatText(data, selectEncoding(), stopAtNul, maxLen);
+}
+
+Value TextInterpretation::decode(IByteIterator& data)
+{
+    return Value::ofText(decodeTextField(data, selectEncoding(), stopAtNul));
+}
+
+void TextInterpretation::getDependencies(vector<Node*>& out)
+{
+    if (flagsNode != NULL)
+    { out.push_back(flagsNode); }
+}
+
+string HexInterpretation::format(IByteIterator& data, Locale Locale, long maxLen)
 {
     string out = "0x";
 
-    char buffer[3];
-    while(data.hasNext())
+    // Two characters per byte after the "0x"
+    long totalLen = data.getSize();
+    long keepLen = totalLen;
+    string suffix = "";
+    if (maxLen != UNBOUNDED && 2 + totalLen * 2 > maxLen)
     {
-        sprintf(buffer, "%02X", data.next());
-        out += buffer;
+        suffix = truncationSuffix(totalLen, maxLen - 2);
+        keepLen = (maxLen - 2 - (long)suffix.size()) / 2;
     }
-    return out;
+
+    if (keepLen < 0)
+    { keepLen = 0; }
+
+    // Encode straight into the result, a chunk of bytes at a time
+    out.resize(2 + keepLen * 2);
+    byte chunk[4096];
+    long doneLen = 0;
+    while (doneLen < keepLen)
+    {
+        long readCnt = data.read(chunk, keepLen - doneLen < (long)sizeof(chunk) ? keepLen - doneLen : sizeof(chunk));
+        if (readCnt <= 0)
+        { break; }
+
+        hexEncode(chunk, readCnt, &out[2 + doneLen * 2]);
+        doneLen += readCnt;
+    }
+    out.resize(2 + doneLen * 2);
+
+    out += suffix;
+
+    // Too little room for even the "0x"
+    return capLength(out, maxLen);
 }
 
-string MsdosDateInterpretation::format(IByteIterator& data, Locale Locale)
+Value MsdosDateInterpretation::decode(IByteIterator& data)
 {
     // We assume two bytes of data for this interpretation
     union
@@ -50,15 +249,22 @@ string MsdosDateInterpretation::format(IByteIterator& data, Locale Locale)
     uint16_t month = (value >> 5) & ((1 << 4) - 1);
     uint16_t day = value & ((1 << 5) - 1);
 
-    return std::to_string(month) + "/" + std::to_string(day) + "/" + std::to_string(year);
+    return Value::ofDate(year, month, day);
+}
+
+string MsdosDateInterpretation::format(IByteIterator& data, Locale Locale, long maxLen)
+{
+    Value date = decode(data);
+
+    return capLength(std::to_string(date.month) + "/" + std::to_string(date.day) + "/" + std::to_string(date.year), maxLen);
 }
 
-string MsdosTimeInterpretation::format(IByteIterator& data, Locale Locale)
+Value MsdosTimeInterpretation::decode(IByteIterator& data)
 {
     // We assume two bytes of data for this interpretation
     union
     {
-        byte buffer[2];
+        byte buffer[2] = {0, 0};
         uint16_t value;
     };
     if (data.hasNext())
@@ -70,300 +276,452 @@ string MsdosTimeInterpretation::format(IByteIterator& data, Locale Locale)
     uint16_t minute = (value >> 5) & ((1 << 6) - 1);
     uint16_t second = (value & ((1 << 5) - 1)) * 2;
 
-    return std::to_string(hour) + ":" + std::to_string(minute) + ":" + std::to_string(second);
+    return Value::ofTime(hour, minute, second);
+}
+
+string MsdosTimeInterpretation::format(IByteIterator& data, Locale Locale, long maxLen)
+{
+    Value time = decode(data);
+
+    return capLength(std::to_string(time.hour) + ":" + std::to_string(time.minute) + ":" + std::to_string(time.second), maxLen);
 }
 
 IntInterpretation::IntInterpretation(uint32_t opts) : opts(opts) {}
 
-bool IntInterpretation::isSystemLittleEndian()
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static const bool HOST_BIG_ENDIAN = true;
+#else
+static const bool HOST_BIG_ENDIAN = false;
+#endif
+
+// Loads a WIDTH-byte integer stored in the given byte order. Both are compile-time constants,
+// so each instance comes down to one load and at most one bswap.
+template<int WIDTH, bool BIG>
+static uint64_t loadUInt(const byte* src)
 {
-    short test = 1;
-    return *(char *)&test;
+    uint64_t value = 0;
+    byte* low = HOST_BIG_ENDIAN ? (byte*)&value + sizeof(value) - WIDTH : (byte*)&value;
+    byte* high = HOST_BIG_ENDIAN ? (byte*)&value : (byte*)&value + sizeof(value) - WIDTH;
+
+    if (BIG == HOST_BIG_ENDIAN)
+    {
+        memcpy(low, src, WIDTH);
+        return value;
+    }
+
+    // Load into the high end, then swap it down
+    memcpy(high, src, WIDTH);
+    return __builtin_bswap64(value);
 }
 
-// TODO: Switch to inttypes.h data type
+typedef uint64_t (*LoadUIntFn)(const byte*);
+
+// Indexed by [big-endian][width in bytes]
+static const LoadUIntFn loadUIntKernels[2][sizeof(uint64_t) + 1] = {
+    {loadUInt<0, false>, loadUInt<1, false>, loadUInt<2, false>, loadUInt<3, false>, loadUInt<4, false>,
+        loadUInt<5, false>, loadUInt<6, false>, loadUInt<7, false>, loadUInt<8, false>},
+    {loadUInt<0, true>, loadUInt<1, true>, loadUInt<2, true>, loadUInt<3, true>, loadUInt<4, true>,
+        loadUInt<5, true>, loadUInt<6, true>, loadUInt<7, true>, loadUInt<8, true>}
+};
+
+// Values wider than 64 bits keep their least-significant 64 bits
 uint64_t IntInterpretation::readAs64Bits(IByteIterator& data, uint32_t opts)
 {
-    uint64_t value = 0;
+    bool bigEndian = (opts & OPT_MASK_ENDIAN) == OPT_BIG_ENDIAN;
+
+    byte buffer[sizeof(uint64_t)];
+    long byteCnt = data.read(buffer, sizeof(buffer));
 
-    // Read source from least-significant byte to most significant byte
-    if ((opts & OPT_MASK_ENDIAN) == OPT_LITTLE_ENDIAN)
+    if (byteCnt == sizeof(buffer) && bigEndian)
     {
-        // Interpret data as Little Endian
-        if (isSystemLittleEndian())
+        // The least-significant bytes come last, so slide the window to the end of the data
+        byte chunk[sizeof(uint64_t)];
+        long chunkCnt;
+        while ((chunkCnt = data.read(chunk, sizeof(chunk))) > 0)
         {
-            // Read source from left to right
-            // Write into the data structure from left to right
-            int valueIdx = 0;
-            while (data.hasNext() && valueIdx < sizeof(uint64_t))
-            {
-                ((byte *)&value)[valueIdx] = data.next();
-                valueIdx++;
-            }
-        } else {
-            // Read source from left to right
-            // Write into the data structure from right to left
-            int valueIdx = sizeof(uint64_t);
-            while (data.hasNext() && valueIdx >= 0)
-            {
-                ((byte *)&value)[valueIdx] = data.next();
-                valueIdx--;
-            }
+            memmove(buffer, buffer + chunkCnt, sizeof(buffer) - chunkCnt);
+            memcpy(buffer + sizeof(buffer) - chunkCnt, chunk, chunkCnt);
         }
-	
-    } else {
-        // Interpret data as Big Endian
+    }
+
+    return loadUIntKernels[bigEndian][byteCnt](buffer);
+}
+
+// Reads every byte of data, least-significant byte first
+static vector<byte> readLittleEndianBytes(IByteIterator& data, uint32_t opts)
+{
+    vector<byte> bytes(data.getSize());
+    bytes.resize(data.read(bytes.data(), bytes.size()));
+
+    if ((opts & IntInterpretation::OPT_MASK_ENDIAN) == IntInterpretation::OPT_BIG_ENDIAN)
+    { reverse(bytes.begin(), bytes.end()); }
+
+    return bytes;
+}
+
+// Formats an integer of any width the way formatValue() does, using schoolbook division on 32-bit limbs
+static string formatWide(const vector<byte>& bytes, uint32_t opts)
+{
+    vector<uint32_t> limbs((bytes.size() + 3) / 4, 0);
+    for (size_t byteIdx = 0; byteIdx < bytes.size(); byteIdx++)
+    {
+        limbs[byteIdx / 4] |= (uint32_t)bytes[byteIdx] << (8 * (byteIdx % 4));
+    }
 
-        // Read source from right to left
-        byte buffer[sizeof(uint64_t)];
-        for (int bufferIdx = 0; bufferIdx < sizeof(uint64_t); bufferIdx++)
+    bool negative = (opts & IntInterpretation::OPT_MASK_SIGN) == IntInterpretation::OPT_SIGNED
+        && !bytes.empty() && (bytes.back() & 0x80);
+    if (negative)
+    {
+        // Two's complement over the field's width; bits past it are sign bits and get cleared by the negation
+        uint64_t carry = 1;
+        for (size_t limbIdx = 0; limbIdx < limbs.size(); limbIdx++)
         {
-            buffer[bufferIdx] = 0;
+            uint32_t limb = limbs[limbIdx];
+            if (limbIdx * 4 + 4 > bytes.size())
+            { limb |= ~(uint32_t)0 << (8 * (bytes.size() % 4)); }
+
+            carry += (uint32_t)~limb;
+            limbs[limbIdx] = (uint32_t)carry;
+            carry >>= 32;
         }
+    }
 
-        int bufferIdx = 0;
-        while (data.hasNext())
+    // Peel off nine decimal digits at a time, least significant first
+    vector<uint32_t> groups;
+    size_t limbCnt = limbs.size();
+    while (limbCnt > 0 && limbs[limbCnt - 1] == 0)
+    { limbCnt--; }
+    while (limbCnt > 0)
+    {
+        uint64_t remainder = 0;
+        for (size_t limbIdx = limbCnt; limbIdx > 0; limbIdx--)
         {
-            buffer[bufferIdx] = data.next();
-            bufferIdx = (bufferIdx + 1) % sizeof(uint64_t);
+            uint64_t cur = (remainder << 32) | limbs[limbIdx - 1];
+            limbs[limbIdx - 1] = (uint32_t)(cur / 1000000000);
+            remainder = cur % 1000000000;
         }
+        groups.push_back((uint32_t)remainder);
+
+        while (limbCnt > 0 && limbs[limbCnt - 1] == 0)
+        { limbCnt--; }
+    }
+
+    string out = negative ? "-" : "";
+    if (groups.empty())
+    { out += "0"; }
+    for (size_t groupIdx = groups.size(); groupIdx > 0; groupIdx--)
+    {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), groupIdx == groups.size() ? "%u" : "%09u", groups[groupIdx - 1]);
+        out += buffer;
+    }
+
+    if ((opts & IntInterpretation::OPT_MASK_HEX) == IntInterpretation::OPT_INCL_HEX)
+    {
+        static const char digits[] = "0123456789ABCDEF";
 
-        if (isSystemLittleEndian())
+        out += " (0x";
+        for (size_t byteIdx = bytes.size(); byteIdx > 0; byteIdx--)
         {
-            // Write into the data structure from left to right
-            for (int valueIdx = 0; valueIdx < sizeof(uint64_t); valueIdx++)
-            {
-                // Read from buffer backwards (right to left), starting from (bufferIdx - 1)
-                bufferIdx = (bufferIdx - 1 + sizeof(uint64_t)) % sizeof(uint64_t);
-
-                ((byte *)&value)[valueIdx] = buffer[bufferIdx];
-            }
-        } else {
-            // Write into the data structure from right to left
-            for (int valueIdx = sizeof(uint64_t); valueIdx > 0; valueIdx--)
-            {
-                // Read from buffer backwards (right to left), starting from (bufferIdx - 1)
-                bufferIdx = (bufferIdx - 1 + sizeof(uint64_t)) % sizeof(uint64_t);
-
-                ((byte *)&value)[valueIdx] = buffer[bufferIdx];
-            }
+            out += digits[bytes[byteIdx - 1] >> 4];
+            out += digits[bytes[byteIdx - 1] & 0xF];
         }
+        out += ")";
     }
 
-    return value;
+    return out;
 }
 
-// TODO
-// WARNING: This interpretation only works up to 64 bits
-string IntInterpretation::format(IByteIterator& data, Locale locale)
+Value IntInterpretation::decode(IByteIterator& data, uint32_t opts)
 {
-    string out = "";
+    long byteCnt = data.getSize();
+    if (byteCnt > (long)sizeof(uint64_t))
+    { return Value::ofBytes(0, byteCnt); }
 
     uint64_t value = readAs64Bits(data, opts);
 
-    // Read source from least-significant byte to most significant byte
-    // Write into the output memory from least significant byte to most significant byte
-    if ((opts & OPT_MASK_ENDIAN) == OPT_LITTLE_ENDIAN)
-    {
-        // Interpret data as Little Endian
+    if ((opts & OPT_MASK_SIGN) == OPT_UNSIGNED)
+    { return Value::ofUInt(value); }
 
-        out = std::to_string(value);
-	
-        // Print hex right to left when little endian
-        if ((opts & OPT_MASK_HEX) == OPT_INCL_HEX)
-        {
-            byte buffer[sizeof(uint16_t)];
-            for (int bufferIdx = 0; bufferIdx < sizeof(uint64_t); bufferIdx++)
-            {
-                buffer[bufferIdx] = 0;
-            }
-
-            int bufferIdx = 0;
-            int dataLen = 0;
-
-            data.reset();
-            while (data.hasNext())
-            {
-                buffer[bufferIdx] = data.next();
-                bufferIdx = (bufferIdx + 1) % sizeof(uint64_t);
-                dataLen++;
-            }
-
-            out = out + " (0x";
-    
-            char charBuffer[3];
-            for (int dataIdx = 0; dataIdx < sizeof(uint64_t) && dataIdx < dataLen; dataIdx++)
-            {
-                // Read from buffer backwards (right to left), starting from (bufferIdx - 1)
-                bufferIdx = (bufferIdx - 1 + sizeof(uint64_t)) % sizeof(uint64_t);
-
-                sprintf(charBuffer, "%02X", buffer[bufferIdx]);
-                out += charBuffer;
-            }
-    
-            out = out + ")";
-        }
-    } else {
-        // Interpret data as Big Endian
+    // Sign-extend from the width of the field
+    if (byteCnt > 0 && byteCnt < (long)sizeof(uint64_t) && (value >> (byteCnt * 8 - 1)) & 0x1)
+    { value |= ~(uint64_t)0 << (byteCnt * 8); }
 
-        out = std::to_string(value);
-	
-        // Print hex left to right when big endian
-        if ((opts & OPT_MASK_HEX) == OPT_INCL_HEX)
-        {
-            out = out + " (0x";
-    
-            char buffer[3];
-            data.reset();
-            while(data.hasNext())
-            {
-                sprintf(buffer, "%02X", data.next());
-                out += buffer;
-            }
-    
-            out = out + ")";
-        }
+    return Value::ofInt((int64_t)value);
+}
+
+Value IntInterpretation::decode(IByteIterator& data)
+{
+    return decode(data, opts);
+}
+
+string IntInterpretation::formatValue(const Value& value, long byteCnt, uint32_t opts)
+{
+    string out = (value.type == Value::TYPE_INT) ? std::to_string(value.intValue) : std::to_string(value.uintValue);
+
+    // Hex is printed most-significant byte first, two digits per byte of the field
+    if ((opts & OPT_MASK_HEX) == OPT_INCL_HEX)
+    {
+        int digitCnt = 2 * (byteCnt < (long)sizeof(uint64_t) ? byteCnt : sizeof(uint64_t));
+        uint64_t bits = value.uintValue;
+        if (digitCnt < 16)
+        { bits &= ((uint64_t)1 << (digitCnt * 4)) - 1; }
+
+        char buffer[20];
+        snprintf(buffer, sizeof(buffer), "%0*" PRIX64, digitCnt, bits);
+        out = out + " (0x" + buffer + ")";
     }
 
     return out;
 }
 
+string IntInterpretation::format(IByteIterator& data, Locale locale, long maxLen)
+{
+    long byteCnt = data.getSize();
+    if (byteCnt <= (long)sizeof(uint64_t))
+    { return capLength(formatValue(decode(data), byteCnt, opts), maxLen); }
+
+    // Wider fields (128-bit IDs, hashes) take the bignum path
+    return capLength(formatWide(readLittleEndianBytes(data, opts), opts), maxLen);
+}
+
 NodeInterpretation::NodeInterpretation(Node* node) : node(node) {}
 
-string NodeInterpretation::format(IByteIterator& data, Locale locale)
+string NodeInterpretation::format(IByteIterator& data, Locale locale, long maxLen)
 {
-    Interpretation* nodeInterpretation = node->pInterpretation;
-    IByteIterator* itr = node->dataNode->accessor->iterator();
+    return formatNode(node, locale, maxLen);
+}
 
-    return nodeInterpretation->format(*itr, locale);
+Value NodeInterpretation::decode(IByteIterator& data)
+{
+    return decodeNode(node);
 }
 
-AdvancedNodeInterpretation::AdvancedNodeInterpretation(string fmtString, initializer_list<Node*> nodes) : fmtString(fmtString), nodes(nodes) {}
+void NodeInterpretation::getDependencies(vector<Node*>& out)
+{
+    out.push_back(node);
+}
 
-// Outputs "fmtString", but with string sequences '$N' where N is a number is replaced by the interpretation of the Nth node in the initializer list.
-// Also, '$$' is replaced with '$'
-// Only '$1' through '$9' are supported
-string AdvancedNodeInterpretation::format(IByteIterator& data, Locale locale)
+AdvancedNodeInterpretation::AdvancedNodeInterpretation(string fmtString, initializer_list<Node*> nodes) : nodes(nodes), refCnts(nodes.size(), 0)
 {
-    vector<string> interpretations;
+    compile(fmtString);
+}
 
-    for (vector<Node*>::iterator iter = nodes.begin(); iter < nodes.end(); iter++)
+// Appends literal text, merging it into the previous op when that is literal too
+void AdvancedNodeInterpretation::addLiteral(const char* text, size_t len)
+{
+    if (!ops.empty() && ops.back().nodeIdx == -1)
+    { ops.back().literalLen += len; }
+    else
     {
-        // TODO: Improve variable names. In particular avoid two usages of iter/itr and interpretation.
-        Interpretation *pInterpretation = (*iter)->pInterpretation;
-        IByteIterator *pItr = (*iter)->dataNode->accessor->iterator();
-        interpretations.push_back(pInterpretation->format(*pItr, locale));
+        Op op = {-1, literals.size(), len};
+        ops.push_back(op);
     }
+    literals.append(text, len);
+}
 
-    string out = "";
-    char flag = '$';
-    bool isFlag = false;
-    const char *fmtStringData = fmtString.c_str();
-    for (uint16_t fmtIdx = 0; fmtStringData[fmtIdx]; fmtIdx++)
+// '$$' becomes '$'. A '$' not followed by the number of a node is kept as written.
+void AdvancedNodeInterpretation::compile(const string& fmtString)
+{
+    const char* fmt = fmtString.c_str();
+    size_t fmtIdx = 0;
+    while (fmt[fmtIdx])
     {
-        char curChar = fmtStringData[fmtIdx];
+        if (fmt[fmtIdx] != '$')
+        {
+            size_t runLen = strcspn(fmt + fmtIdx, "$");
+            addLiteral(fmt + fmtIdx, runLen);
+            fmtIdx += runLen;
+            continue;
+        }
 
-        if (curChar == flag)
+        if (fmt[fmtIdx + 1] == '$')
         {
-            if (isFlag)
-            {
-                out += flag;
-                isFlag = false;
-            } else {
-                isFlag = true;
-            }
+            addLiteral("$", 1);
+            fmtIdx += 2;
             continue;
         }
 
-        if (isFlag)
+        size_t digitCnt = strspn(fmt + fmtIdx + 1, "0123456789");
+        size_t nodeNum = digitCnt > 0 && digitCnt < 10 ? strtoul(fmt + fmtIdx + 1, NULL, 10) : 0;
+        if (nodeNum < 1 || nodeNum > nodes.size())
         {
-            unsigned char flagId = curChar - '1'; // TODO: only flags in range [1,9] are acceptable. Error otherwise.
-            out += interpretations.at(flagId);
-            isFlag = false;
+            addLiteral(fmt + fmtIdx, 1 + digitCnt);
+            fmtIdx += 1 + digitCnt;
             continue;
         }
 
-        out += curChar;
+        Op op = {(int)nodeNum - 1, 0, 0};
+        ops.push_back(op);
+        refCnts[nodeNum - 1]++;
+        fmtIdx += 1 + digitCnt;
     }
+}
 
-    return out;
+string AdvancedNodeInterpretation::format(IByteIterator& data, Locale locale, long maxLen)
+{
+    // Only nodes referenced more than once keep their value around for the rest of the call
+    vector<string> repeated(nodes.size());
+    vector<bool> formatted(nodes.size(), false);
+
+    string out;
+    out.reserve(literals.size() + 32 * nodes.size());
+
+    for (vector<Op>::iterator op = ops.begin(); op < ops.end(); op++)
+    {
+        // Anything past maxLen gets cut, so stop composing once there
+        if (maxLen != UNBOUNDED && (long)out.size() > maxLen)
+        { break; }
+
+        if (op->nodeIdx == -1)
+        {
+            out.append(literals, op->literalOffset, op->literalLen);
+            continue;
+        }
+
+        if (refCnts[op->nodeIdx] == 1)
+        {
+            out += formatNode(nodes[op->nodeIdx], locale, maxLen);
+            continue;
+        }
+
+        if (!formatted[op->nodeIdx])
+        {
+            repeated[op->nodeIdx] = formatNode(nodes[op->nodeIdx], locale, maxLen);
+            formatted[op->nodeIdx] = true;
+        }
+        out += repeated[op->nodeIdx];
+    }
+
+    return capLength(out, maxLen);
 }
-    
 
-FlagsInterpretation::FlagsInterpretation(initializer_list<Flag> flags) : flags(flags) {}
+Value AdvancedNodeInterpretation::decode(IByteIterator& data)
+{
+    return Value::ofText(format(data, LOCALE_EN_US, UNBOUNDED));
+}
+
+// Only the nodes the template references
+void AdvancedNodeInterpretation::getDependencies(vector<Node*>& out)
+{
+    for (size_t nodeIdx = 0; nodeIdx < nodes.size(); nodeIdx++)
+    {
+        if (refCnts[nodeIdx] > 0)
+        { out.push_back(nodes[nodeIdx]); }
+    }
+}
 
-string FlagsInterpretation::format(IByteIterator& data, Locale locale)
+uint64_t FlagsInterpretation::readBits(IByteIterator& data, int* totalNumBits)
 {
     // WARNING: Assumes a flag has 64 bits maximum
     uint64_t buffer = 0;
-    byte* pBuffer = (byte*)&buffer;
-    uint8_t totalNumBits = 0;
-    for (unsigned int bufferIdx = 0; data.hasNext(); bufferIdx++)
+    *totalNumBits = data.read((byte*)&buffer, sizeof(buffer)) * 8;
+    return buffer;
+}
+
+// Extracts flag flagIdx, which starts at *startBitIdx, and moves *startBitIdx past it
+uint32_t FlagsInterpretation::flagValue(uint64_t bits, int* startBitIdx, size_t flagIdx) const
+{
+    int numBits = flags[flagIdx].getNumBits();
+
+    // TODO: Confirm we're doing big-endian vs little-endian correctly
+    uint32_t value = (bits >> (*startBitIdx - numBits + 1)) & ((0x1 << numBits) - 1);
+
+    *startBitIdx -= numBits;
+    return value;
+}
+
+Value FlagsInterpretation::decode(IByteIterator& data)
+{
+    int totalNumBits;
+    uint64_t bits = readBits(data, &totalNumBits);
+
+    vector<uint32_t> values(flagCnt);
+    int startBitIdx = totalNumBits - 1;
+    for (size_t flagIdx = 0; flagIdx < flagCnt; flagIdx++)
     {
-        pBuffer[bufferIdx] = data.next();
-        totalNumBits += 8;
+        values[flagIdx] = flagValue(bits, &startBitIdx, flagIdx);
     }
 
+    return Value::ofFlags(bits, values);
+}
+
+string FlagsInterpretation::format(IByteIterator& data, Locale locale, long maxLen)
+{
+    int totalNumBits;
+    uint64_t bits = readBits(data, &totalNumBits);
+
     string out = "";
+    out.reserve(flagCnt * 32);
 
-    int8_t startBitIdx = totalNumBits - 1;
-    for (vector<Flag>::iterator iter = flags.begin(); iter < flags.end(); iter++)
+    int startBitIdx = totalNumBits - 1;
+    for (size_t flagIdx = 0; flagIdx < flagCnt; flagIdx++)
     {
-        int8_t numBits = iter->getNumBits();
+        int numBits = flags[flagIdx].getNumBits();
+        uint32_t value = flagValue(bits, &startBitIdx, flagIdx);
 
-        // TODO: Confirm we're doing big-endian vs little-endian correctly
-        uint64_t value = (buffer >> (startBitIdx - numBits + 1)) & ((0x1 << numBits) - 1);
-        for (int8_t bitIdx = startBitIdx; bitIdx > startBitIdx - numBits; bitIdx--)
+        // The flag's bits, most significant first
+        char bitChars[32];
+        for (int bitIdx = 0; bitIdx < numBits; bitIdx++)
         {
-          if (((buffer >> bitIdx) & 0x1) == 0x1)
-          { out += "1"; }
-          else
-          { out += "0"; }
+            bitChars[bitIdx] = '0' + ((value >> (numBits - 1 - bitIdx)) & 0x1);
         }
+        out.append(bitChars, numBits);
+
         out += " (";
-        out += iter->getInterpretation(value);
+        out += flags[flagIdx].getInterpretation(value);
         out += ") ";
-
-        startBitIdx -= numBits;
     }
 
-    return out;
-}
-
-FlagsInterpretation::Flag::Flag(uint8_t numBits, initializer_list<string> flagValues): numBits(numBits), flagValues(flagValues) {}
-
-FlagsInterpretation::Flag::Flag(uint8_t numBits, string flagValue): numBits(numBits)
-{
-    flagValues = vector<string>(1 << numBits, flagValue);
+    return capLength(out, maxLen);
 }
 
-uint8_t FlagsInterpretation::Flag::getNumBits()
+const char* FlagsInterpretation::Flag::getInterpretation(unsigned int value) const
 {
-    return numBits;
-}
+    if (flagValues == NULL)
+    { return flagValue; }
 
-string FlagsInterpretation::Flag::getInterpretation(unsigned int value)
-{
-    return flagValues.at(value);
+    return value < flagValueCnt ? flagValues[value] : "";
 }
 
 ConditionalInterpretation::ConditionalInterpretation(Node* node, Interpretation* pDefault, initializer_list<Condition> conditions): node(node), pDefault(pDefault), conditions(conditions) {}
 
-string ConditionalInterpretation::format(IByteIterator& data, Locale locale)
+// Picks the interpretation matching the current value of the node this one depends on
+Interpretation* ConditionalInterpretation::select()
 {
-    IByteIterator* itr = node->dataNode->accessor->iterator();
-
-    uint64_t nodeValue = IntInterpretation::readAs64Bits(*itr, IntInterpretation::OPT_LITTLE_ENDIAN);
+    uint64_t nodeValue = decodeNode(node).asUInt();
 
     for (vector<Condition>::iterator condIter = conditions.begin(); condIter < conditions.end(); condIter++)
     {
         if (condIter->getValueMatch() == nodeValue)
         {
-            return condIter->getpInterpretation()->format(data, locale);
+            return condIter->getpInterpretation();
         }
     }
 
-    return pDefault->format(data, locale);
+    return pDefault;
+}
+
+string ConditionalInterpretation::format(IByteIterator& data, Locale locale, long maxLen)
+{
+    return select()->format(data, locale, maxLen);
+}
+
+Value ConditionalInterpretation::decode(IByteIterator& data)
+{
+    return select()->decode(data);
+}
+
+// The selecting node, plus whatever any of the candidates may read
+void ConditionalInterpretation::getDependencies(vector<Node*>& out)
+{
+    out.push_back(node);
+
+    pDefault->getDependencies(out);
+    for (vector<Condition>::iterator condIter = conditions.begin(); condIter < conditions.end(); condIter++)
+    {
+        condIter->getpInterpretation()->getDependencies(out);
+    }
 }
 
 ConditionalInterpretation::Condition::Condition(uint64_t valueMatch, Interpretation* pInterpretation): valueMatch(valueMatch), pInterpretation(pInterpretation) {}
@@ -378,42 +736,42 @@ Interpretation* ConditionalInterpretation::Condition::getpInterpretation()
     return pInterpretation;
 }
 
-EnumInterpretation::Enum::Enum(uint64_t valueMatch, string meaning): valueMatch(valueMatch), meaning(meaning) {}
-
-uint64_t EnumInterpretation::Enum::getValueMatch()
+const char* EnumInterpretation::lookup(uint64_t value) const
 {
-    return valueMatch;
+    if (dense)
+    { return value < enumCnt ? enums[value].getMeaning() : defaultMeaning; }
+
+    size_t lowIdx = 0;
+    size_t highIdx = enumCnt;
+    while (lowIdx < highIdx)
+    {
+        size_t midIdx = lowIdx + (highIdx - lowIdx) / 2;
+        if (enums[midIdx].getValueMatch() < value)
+        { lowIdx = midIdx + 1; }
+        else
+        { highIdx = midIdx; }
+    }
+
+    if (lowIdx < enumCnt && enums[lowIdx].getValueMatch() == value)
+    { return enums[lowIdx].getMeaning(); }
+
+    return defaultMeaning;
 }
 
-string EnumInterpretation::Enum::getMeaning()
+Value EnumInterpretation::decode(IByteIterator& data)
 {
-    return meaning;
+    return IntInterpretation::decode(data, opts);
 }
 
-EnumInterpretation::EnumInterpretation(string defaultMeaning, uint32_t opts, initializer_list<Enum> enums): defaultMeaning(defaultMeaning), opts(opts), enums(enums) {}
-
-string EnumInterpretation::format(IByteIterator& data, Locale locale)
+string EnumInterpretation::format(IByteIterator& data, Locale locale, long maxLen)
 {
-    uint64_t nodeValue = IntInterpretation::readAs64Bits(data, opts);
-    data.reset();
+    Value value = decode(data);
 
-    IntInterpretation intInterp = IntInterpretation(opts);
-    string out = intInterp.format(data, locale);
+    string out = IntInterpretation::formatValue(value, data.getSize(), opts);
     out += " (";
-    
-    for (vector<Enum>::iterator enumIter = enums.begin(); enumIter < enums.end(); enumIter++)
-    {
-        if (enumIter->getValueMatch() == nodeValue)
-        {
-            out += enumIter->getMeaning();
-            out += ")";
-            return out;
-        }
-    }
-
-    out += defaultMeaning;
+    out += lookup(value.uintValue);
     out += ")";
-    return out;
+    return capLength(out, maxLen);
 }
 
 Interpretation* Interpretation::asciz = new AscizInterpretation();
@@ -5,6 +5,7 @@
 #include <vector>
 #include <initializer_list>
 #include "byteIterator.h"
+#include "textDecode.h"
 #include <inttypes.h>
 
 class Interpretation;
@@ -18,10 +19,70 @@ enum Locale
     LOCALE_EN_US
 };
 
+// A node's value in a form code can use directly, without parsing formatted text. See Interpretation::decode.
+class Value
+{
+public:
+    enum Type
+    {
+        TYPE_NONE,
+        TYPE_UINT,      // uintValue
+        TYPE_INT,       // intValue
+        TYPE_BYTES,     // offset and length: a range of the node's bytes, left undecoded
+        TYPE_DATE,      // year, month and day
+        TYPE_TIME,      // hour, minute and second
+        TYPE_FLAGS,     // flags holds one value per flag field, in declaration order. uintValue holds the raw bits.
+        TYPE_TEXT       // text
+    };
+
+    Type type;
+
+    union
+    {
+        uint64_t uintValue;
+        int64_t intValue;
+    };
+
+    long offset;
+    long length;
+
+    uint16_t year;
+    uint8_t month, day;
+    uint8_t hour, minute, second;
+
+    vector<uint32_t> flags;
+    string text;
+
+    Value();
+
+    static Value ofUInt(uint64_t value);
+    static Value ofInt(int64_t value);
+    static Value ofBytes(long offset, long length);
+    static Value ofDate(uint16_t year, uint8_t month, uint8_t day);
+    static Value ofTime(uint8_t hour, uint8_t minute, uint8_t second);
+    static Value ofFlags(uint64_t bits, const vector<uint32_t>& flags);
+    static Value ofText(const string& text);
+
+    // Integer and flag values as an unsigned number; 0 for other types
+    uint64_t asUInt() const;
+};
+
 class Interpretation
 {
 public:
-    virtual string format(IByteIterator&, Locale) = 0;
+    static const long UNBOUNDED = -1;
+
+    virtual ~Interpretation() {}
+
+    // maxLen caps the length of the result. Longer values are cut short with "... (N bytes)"
+    // rather than read in full, so formatting a huge node stays cheap.
+    virtual string format(IByteIterator&, Locale, long maxLen = UNBOUNDED) = 0;
+
+    // Typed counterpart of format(). By default the value is left as the range of bytes it covers.
+    virtual Value decode(IByteIterator&);
+
+    // Appends the nodes, other than the one being interpreted, whose values this interpretation reads
+    virtual void getDependencies(vector<Node*>& out) {}
 
     static Interpretation* asciz;
     static Interpretation* ascii;
@@ -33,27 +94,52 @@ public:
 class AscizInterpretation : public Interpretation
 {
 public:
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
 };
 
 class AsciiInterpretation : public Interpretation
 {
 public:
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
+};
+
+// Text in a fixed encoding, or in the encoding a zip Flags node selects: UTF-8 when bit 11 is set, CP437 otherwise.
+// Formatting escapes bytes that cannot be shown; decoding keeps them.
+class TextInterpretation : public Interpretation
+{
+public:
+    static const uint64_t FLAG_UTF8 = 0x0800;
+
+    TextInterpretation(TextEncoding encoding, bool stopAtNul = false);
+    TextInterpretation(Node* flagsNode);
+
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
+    void getDependencies(vector<Node*>& out);
+
+private:
+    Node* flagsNode;
+    TextEncoding encoding;
+    bool stopAtNul;
+
+    TextEncoding selectEncoding();
 };
 
 class HexInterpretation : public Interpretation
 {
 public:
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
 };
 
-// TODO
-// WARNING: This interpretation only works up to 64 bits
+// Integers of any width. Fields of up to 8 bytes decode to a Value; wider ones (128-bit IDs, hashes)
+// decode as bytes and format through a bignum path.
 class IntInterpretation : public Interpretation
 {
 public:
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
 
     enum OPTIONS {
         OPT_NONE = 0x0,
@@ -64,29 +150,37 @@ public:
 
         OPT_MASK_HEX = 0x02,
         OPT_INCL_HEX = 0x00,
-        OPT_EXCL_HEX = 0x02
+        OPT_EXCL_HEX = 0x02,
+
+        OPT_MASK_SIGN = 0x04,
+        OPT_UNSIGNED = 0x00,
+        OPT_SIGNED = 0x04   // Two's complement
     };
 
     IntInterpretation(uint32_t opts);
 
     static uint64_t readAs64Bits(IByteIterator&, uint32_t opts);
+    static Value decode(IByteIterator&, uint32_t opts);
+
+    // Formats a decoded integer of byteCnt bytes the way format() does
+    static string formatValue(const Value& value, long byteCnt, uint32_t opts);
 
 private:
     uint32_t opts;
-
-    static bool isSystemLittleEndian();
 };
 
 class MsdosDateInterpretation : public Interpretation
 {
 public:
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
 };
 
 class MsdosTimeInterpretation : public Interpretation
 {
 public:
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
 };
 
 class NodeInterpretation : public Interpretation
@@ -94,25 +188,45 @@ class NodeInterpretation : public Interpretation
 public:
     NodeInterpretation(Node* node);
 
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
+    void getDependencies(vector<Node*>& out);
 
 private:
     Node* node;
 };
 
 // TODO: Should this be combined into NodeInterpretation?
+// Formats a template where "$N" stands for the Nth node (1-based, any number of digits) and "$$" for "$".
+// The template is compiled once into ops at construction.
 class AdvancedNodeInterpretation : public Interpretation
 {
 public:
     AdvancedNodeInterpretation(string fmtString, initializer_list<Node*> nodes);
 
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);    // The formatted text
+    void getDependencies(vector<Node*>& out);
 
 private:
-    string fmtString;
+    // Either a run of literal text or a reference to one of the nodes
+    struct Op
+    {
+        int nodeIdx;            // -1 for literal text
+        size_t literalOffset;   // Into literals
+        size_t literalLen;
+    };
+
     vector<Node*> nodes;
+    vector<int> refCnts;    // Times each node is referenced
+    vector<Op> ops;
+    string literals;
+
+    void compile(const string& fmtString);
+    void addLiteral(const char* text, size_t len);
 };
 
+// Flag tables are plain constant arrays, so definitions cost nothing at startup and nothing is copied
 class FlagsInterpretation : public Interpretation
 {
 public:
@@ -120,23 +234,35 @@ public:
     {
     public:
         // TODO: Use different term than "interpretation", which is already used to mean something else
-        Flag(uint8_t numBits, initializer_list<string> flagValues);
-        Flag(uint8_t numBits, string flagValue); // Sets all bit sequences to the same meaning -- commonly used for "unused" or "reserved" bits
-    
-        uint8_t getNumBits();
-        string getInterpretation(unsigned int value);
-    
+        // flagValues needs one entry per bit sequence, i.e. 1 << numBits of them
+        template<size_t N>
+        constexpr Flag(uint8_t numBits, const char* const (&flagValues)[N]) : numBits(numBits), flagValues(flagValues), flagValueCnt(N), flagValue("") {}
+        // Sets all bit sequences to the same meaning -- commonly used for "unused" or "reserved" bits
+        constexpr Flag(uint8_t numBits, const char* flagValue) : numBits(numBits), flagValues(NULL), flagValueCnt(0), flagValue(flagValue) {}
+
+        constexpr uint8_t getNumBits() const { return numBits; }
+        const char* getInterpretation(unsigned int value) const;
+
     private:
         uint8_t numBits;
-        vector<string> flagValues;
+        const char* const* flagValues;
+        size_t flagValueCnt;
+        const char* flagValue;
     };
 
-    FlagsInterpretation(initializer_list<Flag> flags);
+    template<size_t N>
+    constexpr FlagsInterpretation(const Flag (&flags)[N]) : flags(flags), flagCnt(N) {}
 
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
 
 private:
-    vector<Flag> flags;
+    const Flag* flags;
+    size_t flagCnt;
+
+    // Reads the whole field; flags are then taken from the most significant bit down
+    static uint64_t readBits(IByteIterator&, int* totalNumBits);
+    uint32_t flagValue(uint64_t bits, int* startBitIdx, size_t flagIdx) const;
 };
 
 // Allows for one of several interpretations to be selected based on the value of another node
@@ -158,38 +284,61 @@ public:
 
     ConditionalInterpretation(Node* node, Interpretation* pDefault, initializer_list<Condition> conditions);
 
-    string format(IByteIterator&, Locale);
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
+    void getDependencies(vector<Node*>& out);
 
 private:
     Node* node;
     Interpretation* pDefault;
     vector<Condition> conditions;
+
+    Interpretation* select();
 };
 
+/* Maps integer values to meanings through a constant table sorted by value, which is checked at compile
+ * time with isSorted(). Tables covering 0..N-1 are indexed directly; others are binary searched.
+ */
 class EnumInterpretation : public Interpretation
 {
 public:
     class Enum
     {
     public:
-        Enum(uint64_t valueMatch, string meaning);
+        constexpr Enum(uint64_t valueMatch, const char* meaning) : valueMatch(valueMatch), meaning(meaning) {}
 
-        uint64_t getValueMatch();
-        string getMeaning();
+        constexpr uint64_t getValueMatch() const { return valueMatch; }
+        constexpr const char* getMeaning() const { return meaning; }
 
     private:
         uint64_t valueMatch;
-        string meaning;
+        const char* meaning;
     };
 
-    EnumInterpretation(string defaultMeaning, uint32_t opts, initializer_list<Enum> enums);
+    template<size_t N>
+    constexpr EnumInterpretation(const char* defaultMeaning, uint32_t opts, const Enum (&enums)[N]) :
+        defaultMeaning(defaultMeaning), opts(opts), enums(enums), enumCnt(N), dense(isDense(enums, N, 0)) {}
+
+    string format(IByteIterator&, Locale, long maxLen);
+    Value decode(IByteIterator&);
+
+    const char* lookup(uint64_t value) const;
 
-    string format(IByteIterator&, Locale);
+    template<size_t N>
+    static constexpr bool isSorted(const Enum (&enums)[N]) { return isSorted(enums, N, 1); }
 
 private:
-    string defaultMeaning;
+    const char* defaultMeaning;
     uint32_t opts;
-    vector<Enum> enums;
+    const Enum* enums;
+    size_t enumCnt;
+    bool dense;     // enums[i] matches value i for every i
+
+    static constexpr bool isSorted(const Enum* enums, size_t enumCnt, size_t idx)
+    { return idx >= enumCnt || (enums[idx - 1].getValueMatch() < enums[idx].getValueMatch() && isSorted(enums, enumCnt, idx + 1)); }
+
+    static constexpr bool isDense(const Enum* enums, size_t enumCnt, size_t idx)
+    { return idx >= enumCnt || (enums[idx].getValueMatch() == idx && isDense(enums, enumCnt, idx + 1)); }
 };
 
 #endif
@@ -0,0 +1,101 @@
+#include "nodeIndex.h"
+
+#include <algorithm>
+
+NodeIndex::NodeIndex(Node* root) : nodeCnt(0)
+{
+    addNode(root, 0);
+
+    sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+        return (a.start != b.start) ? a.start < b.start : a.order < b.order;
+    });
+    computeMaxEnds(0, spans.size());
+}
+
+void NodeIndex::addNode(Node* node, int depth)
+{
+    long order = nodeCnt++;
+
+    for (int segIdx = 0; segIdx < node->segmentCnt; segIdx++)
+    {
+        Segment segment = absoluteSegment(node, segIdx);
+        Span span = {segment.offset, segment.offset + segment.length, 0, order, depth, node};
+        spans.push_back(span);
+    }
+
+    // Children are not always inside their parent's range, so every branch is indexed
+    for (Node* child = node->firstChild; child != NULL; child = child->nextSibling)
+    {
+        addNode(child, depth + 1);
+    }
+}
+
+// Spans [first, last) form a subtree rooted at their middle. Returns its greatest end.
+long NodeIndex::computeMaxEnds(long first, long last)
+{
+    if (first >= last)
+    { return 0; }
+
+    long middle = first + (last - first) / 2;
+    long maxEnd = spans[middle].end;
+    maxEnd = max(maxEnd, computeMaxEnds(first, middle));
+    maxEnd = max(maxEnd, computeMaxEnds(middle + 1, last));
+
+    spans[middle].maxEnd = maxEnd;
+    return maxEnd;
+}
+
+// Appends the indexes of the spans among [first, last) that overlap [offset, offset + length)
+void NodeIndex::findRecur(long first, long last, long offset, long length, vector<long>& out)
+{
+    if (first >= last)
+    { return; }
+
+    long middle = first + (last - first) / 2;
+    if (spans[middle].maxEnd <= offset)
+    { return; }
+
+    findRecur(first, middle, offset, length, out);
+
+    // Spans after the middle start no earlier
+    if (spans[middle].start >= offset + length)
+    { return; }
+
+    if (offset < spans[middle].end)
+    { out.push_back(middle); }
+
+    findRecur(middle + 1, last, offset, length, out);
+}
+
+vector<Node*> NodeIndex::findOverlapping(long offset, long length)
+{
+    vector<long> found;
+    findRecur(0, spans.size(), offset, length, found);
+
+    // A node with several segments may be found once for each
+    sort(found.begin(), found.end(), [this](long a, long b) { return spans[a].order < spans[b].order; });
+
+    vector<Node*> out;
+    for (vector<long>::iterator iter = found.begin(); iter < found.end(); iter++)
+    {
+        if (out.empty() || out.back() != spans[*iter].node)
+        { out.push_back(spans[*iter].node); }
+    }
+    return out;
+}
+
+Node* NodeIndex::findAt(long offset)
+{
+    vector<long> found;
+    findRecur(0, spans.size(), offset, 1, found);
+
+    // Of nodes equally deep, the first in the tree
+    Span* deepest = NULL;
+    for (vector<long>::iterator iter = found.begin(); iter < found.end(); iter++)
+    {
+        Span* span = &spans[*iter];
+        if (deepest == NULL || span->depth > deepest->depth || (span->depth == deepest->depth && span->order < deepest->order))
+        { deepest = span; }
+    }
+    return (deepest != NULL) ? deepest->node : NULL;
+}
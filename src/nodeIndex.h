@@ -0,0 +1,50 @@
+#ifndef BINVIEW_NODE_INDEX
+#define BINVIEW_NODE_INDEX
+
+#include <vector>
+
+#include "hierarchy.h"
+
+using namespace std;
+
+/* Finds the nodes covering bytes of the file in O(log n + k), rather than walking the tree.
+ *
+ * Each segment of each node is a span of absolute offsets. Spans are sorted by start, and the sorted array is read as
+ * a balanced binary tree: the middle of any range is the parent of the middles of its halves. Each span also records
+ * the greatest end within its subtree, so subtrees ending before the bytes asked about are skipped whole.
+ *
+ * Like DependencyGraph, the index is a snapshot: rebuild it if nodes are added to or removed from the tree.
+ */
+class NodeIndex
+{
+public:
+    NodeIndex(Node* root);
+
+    // Nodes whose bytes overlap [offset, offset + length) of the file, each once, in tree order
+    vector<Node*> findOverlapping(long offset, long length);
+
+    // The deepest node holding the byte at offset, or NULL if none does
+    Node* findAt(long offset);
+
+    long getNodeCnt() { return nodeCnt; }
+
+private:
+    struct Span
+    {
+        long start;
+        long end;
+        long maxEnd;    // Greatest end in the subtree under this span
+        long order;     // Of its node, in a depth-first walk of the tree
+        int depth;
+        Node* node;
+    };
+
+    vector<Span> spans;
+    long nodeCnt;
+
+    void addNode(Node* node, int depth);
+    long computeMaxEnds(long first, long last);
+    void findRecur(long first, long last, long offset, long length, vector<long>& out);
+};
+
+#endif
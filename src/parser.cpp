@@ -4,6 +4,9 @@
 #include <string.h>
 #include <inttypes.h>
 
+#include "entryTable.h"
+#include "formatCache.h"
+
 /*
  * Read up to n characters into *out, or until EOF
  * Returns actual number of characters read
@@ -20,13 +23,13 @@ long peek(FILE *fp, long n, char *out);
  */
 long peekRelative(FILE *fp, long offset, long n, char *out);
 
-long readLocalFileHeader(FILE *fp, long offset, Node *parentNode);
+long readLocalFileHeader(FILE *fp, long offset, uint32_t compressedSize, Node *parentNode);
+long readDataDescriptor(FILE *fp, long offset, Node *parentNode);
 long readExtraField(FILE *fp, long offset, Node *parentNode);
-long readCentralDirectory(FILE *fp, long offset, Node *parentNode);
 long readCentralDirectoryFileHeader(FILE *fp, long offset, Node *parentNode);
 long readEndOfCentralDirectoryRecord(FILE *fp, long offset, Node *parentNode);
 
-EnumInterpretation *compressionInterpretation = new EnumInterpretation("unknown", IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN, {
+static constexpr EnumInterpretation::Enum COMPRESSION_METHODS[] = {
     EnumInterpretation::Enum(0, "no compression"),
     EnumInterpretation::Enum(1, "shrunk"),
     EnumInterpretation::Enum(2, "reduced with compression factor 1"),
@@ -55,174 +58,592 @@ EnumInterpretation *compressionInterpretation = new EnumInterpretation("unknown"
     EnumInterpretation::Enum(97, "WavPack"),
     EnumInterpretation::Enum(98, "PPMd version I, Rev 1"),
     EnumInterpretation::Enum(99, "AE-x encryption marker")
-});
-
-FlagsInterpretation* pDefaultFlagsInterp = new FlagsInterpretation{
-        FlagsInterpretation::Flag(1, {"unencrypted", "encrypted"}), // bit 0
-        FlagsInterpretation::Flag(2, "undefined"), // bits 1-2
-        FlagsInterpretation::Flag(1, {"fields set in local header", "fields set in data descriptor"}), // bit 3
-        FlagsInterpretation::Flag(1, "reserved"), // bit 4
-        FlagsInterpretation::Flag(1, {"not compressed patched data", "compressed patched data"}), // bit 5
-        FlagsInterpretation::Flag(1, {"no strong encryption", "strong encryption"}), // bit 6
-        FlagsInterpretation::Flag(4, "unused"), // bits 7-10
-        FlagsInterpretation::Flag(1, {"", "UTF-8 field encoding"}), // bit 11
-        FlagsInterpretation::Flag(1, "reserved"), // bit 12
-        FlagsInterpretation::Flag(1, {"", "Local Header fields masked"}), // bit 13
-        FlagsInterpretation::Flag(1, "reserved"), // bit 14
-        FlagsInterpretation::Flag(1, "reserved") // bit 15
-    };
-FlagsInterpretation* pMethod6FlagsInterp = new FlagsInterpretation{
-        FlagsInterpretation::Flag(1, {"unencrypted", "encrypted"}), // bit 0
-        FlagsInterpretation::Flag(1, {"4K sliding dict", "8k sliding dict"}), // bit 1
-        FlagsInterpretation::Flag(1, {"2 Shannon-Fano trees", "3 Shannon-Fano trees"}), // bit 2
-        FlagsInterpretation::Flag(1, {"fields set in local header", "fields set in data descriptor"}), // bit 3
-        FlagsInterpretation::Flag(1, "reserved"), // bit 4
-        FlagsInterpretation::Flag(1, {"not compressed patched data", "compressed patched data"}), // bit 5
-        FlagsInterpretation::Flag(1, {"no strong encryption", "strong encryption"}), // bit 6
-        FlagsInterpretation::Flag(4, "unused"), // bits 7-10
-        FlagsInterpretation::Flag(1, {"", "UTF-8 field encoding"}), // bit 11
-        FlagsInterpretation::Flag(1, "reserved"), // bit 12
-        FlagsInterpretation::Flag(1, {"", "Local Header fields masked"}), // bit 13
-        FlagsInterpretation::Flag(1, "reserved"), // bit 14
-        FlagsInterpretation::Flag(1, "reserved") // bit 15
-    };
-FlagsInterpretation* pMethod89FlagsInterp = new FlagsInterpretation{
-        FlagsInterpretation::Flag(1, {"unencrypted", "encrypted"}), // bit 0
-        FlagsInterpretation::Flag(2, {"normal compression", "maximum compression", "fast compression", "super fast compression"}), // bits 1-2
-        FlagsInterpretation::Flag(1, {"fields set in local header", "fields set in data descriptor"}), // bit 3
-        FlagsInterpretation::Flag(1, "reserved"), // bit 4
-        FlagsInterpretation::Flag(1, {"not compressed patched data", "compressed patched data"}), // bit 5
-        FlagsInterpretation::Flag(1, {"no strong encryption", "strong encryption"}), // bit 6
-        FlagsInterpretation::Flag(4, "unused"), // bits 7-10
-        FlagsInterpretation::Flag(1, {"", "UTF-8 field encoding"}), // bit 11
-        FlagsInterpretation::Flag(1, "reserved"), // bit 12
-        FlagsInterpretation::Flag(1, {"", "Local Header fields masked"}), // bit 13
-        FlagsInterpretation::Flag(1, "reserved"), // bit 14
-        FlagsInterpretation::Flag(1, "reserved") // bit 15
-    };
-FlagsInterpretation* pMethod14FlagsInterp = new FlagsInterpretation{
-        FlagsInterpretation::Flag(1, {"unencrypted", "encrypted"}), // bit 0
-        FlagsInterpretation::Flag(1, {"no EOS marker", "EOS marker used"}), // bit 1
-        FlagsInterpretation::Flag(1, "undefined"), // bit 2
-        FlagsInterpretation::Flag(1, {"fields set in local header", "fields set in data descriptor"}), // bit 3
-        FlagsInterpretation::Flag(1, "reserved"), // bit 4
-        FlagsInterpretation::Flag(1, {"not compressed patched data", "compressed patched data"}), // bit 5
-        FlagsInterpretation::Flag(1, {"no strong encryption", "strong encryption"}), // bit 6
-        FlagsInterpretation::Flag(4, "unused"), // bits 7-10
-        FlagsInterpretation::Flag(1, {"", "UTF-8 field encoding"}), // bit 11
-        FlagsInterpretation::Flag(1, "reserved"), // bit 12
-        FlagsInterpretation::Flag(1, {"", "Local Header fields masked"}), // bit 13
-        FlagsInterpretation::Flag(1, "reserved"), // bit 14
-        FlagsInterpretation::Flag(1, "reserved") // bit 15
-    };
-
-Node *parse(FILE *fp)
+};
+static_assert(EnumInterpretation::isSorted(COMPRESSION_METHODS), "COMPRESSION_METHODS must be sorted by value");
+static EnumInterpretation compressionMethodInterp("unknown", IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN, COMPRESSION_METHODS);
+EnumInterpretation *compressionInterpretation = &compressionMethodInterp;
+
+static constexpr const char* ENCRYPTION[] = {"unencrypted", "encrypted"};
+static constexpr const char* DATA_DESCRIPTOR[] = {"fields set in local header", "fields set in data descriptor"};
+static constexpr const char* PATCHED_DATA[] = {"not compressed patched data", "compressed patched data"};
+static constexpr const char* STRONG_ENCRYPTION[] = {"no strong encryption", "strong encryption"};
+static constexpr const char* UTF8_ENCODING[] = {"", "UTF-8 field encoding"};
+static constexpr const char* MASKED_HEADER[] = {"", "Local Header fields masked"};
+static constexpr const char* IMPLODE_DICT_SIZE[] = {"4K sliding dict", "8k sliding dict"};
+static constexpr const char* IMPLODE_TREE_CNT[] = {"2 Shannon-Fano trees", "3 Shannon-Fano trees"};
+static constexpr const char* DEFLATE_LEVEL[] = {"normal compression", "maximum compression", "fast compression", "super fast compression"};
+static constexpr const char* LZMA_EOS_MARKER[] = {"no EOS marker", "EOS marker used"};
+
+// General purpose flag: the CRC and sizes follow the data, and the local header may hold zeros
+static const uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+
+static constexpr FlagsInterpretation::Flag DEFAULT_FLAGS[] = {
+    FlagsInterpretation::Flag(1, ENCRYPTION), // bit 0
+    FlagsInterpretation::Flag(2, "undefined"), // bits 1-2
+    FlagsInterpretation::Flag(1, DATA_DESCRIPTOR), // bit 3
+    FlagsInterpretation::Flag(1, "reserved"), // bit 4
+    FlagsInterpretation::Flag(1, PATCHED_DATA), // bit 5
+    FlagsInterpretation::Flag(1, STRONG_ENCRYPTION), // bit 6
+    FlagsInterpretation::Flag(4, "unused"), // bits 7-10
+    FlagsInterpretation::Flag(1, UTF8_ENCODING), // bit 11
+    FlagsInterpretation::Flag(1, "reserved"), // bit 12
+    FlagsInterpretation::Flag(1, MASKED_HEADER), // bit 13
+    FlagsInterpretation::Flag(1, "reserved"), // bit 14
+    FlagsInterpretation::Flag(1, "reserved") // bit 15
+};
+static FlagsInterpretation defaultFlagsInterp(DEFAULT_FLAGS);
+FlagsInterpretation* pDefaultFlagsInterp = &defaultFlagsInterp;
+
+static constexpr FlagsInterpretation::Flag METHOD6_FLAGS[] = {
+    FlagsInterpretation::Flag(1, ENCRYPTION), // bit 0
+    FlagsInterpretation::Flag(1, IMPLODE_DICT_SIZE), // bit 1
+    FlagsInterpretation::Flag(1, IMPLODE_TREE_CNT), // bit 2
+    FlagsInterpretation::Flag(1, DATA_DESCRIPTOR), // bit 3
+    FlagsInterpretation::Flag(1, "reserved"), // bit 4
+    FlagsInterpretation::Flag(1, PATCHED_DATA), // bit 5
+    FlagsInterpretation::Flag(1, STRONG_ENCRYPTION), // bit 6
+    FlagsInterpretation::Flag(4, "unused"), // bits 7-10
+    FlagsInterpretation::Flag(1, UTF8_ENCODING), // bit 11
+    FlagsInterpretation::Flag(1, "reserved"), // bit 12
+    FlagsInterpretation::Flag(1, MASKED_HEADER), // bit 13
+    FlagsInterpretation::Flag(1, "reserved"), // bit 14
+    FlagsInterpretation::Flag(1, "reserved") // bit 15
+};
+static FlagsInterpretation method6FlagsInterp(METHOD6_FLAGS);
+FlagsInterpretation* pMethod6FlagsInterp = &method6FlagsInterp;
+
+static constexpr FlagsInterpretation::Flag METHOD89_FLAGS[] = {
+    FlagsInterpretation::Flag(1, ENCRYPTION), // bit 0
+    FlagsInterpretation::Flag(2, DEFLATE_LEVEL), // bits 1-2
+    FlagsInterpretation::Flag(1, DATA_DESCRIPTOR), // bit 3
+    FlagsInterpretation::Flag(1, "reserved"), // bit 4
+    FlagsInterpretation::Flag(1, PATCHED_DATA), // bit 5
+    FlagsInterpretation::Flag(1, STRONG_ENCRYPTION), // bit 6
+    FlagsInterpretation::Flag(4, "unused"), // bits 7-10
+    FlagsInterpretation::Flag(1, UTF8_ENCODING), // bit 11
+    FlagsInterpretation::Flag(1, "reserved"), // bit 12
+    FlagsInterpretation::Flag(1, MASKED_HEADER), // bit 13
+    FlagsInterpretation::Flag(1, "reserved"), // bit 14
+    FlagsInterpretation::Flag(1, "reserved") // bit 15
+};
+static FlagsInterpretation method89FlagsInterp(METHOD89_FLAGS);
+FlagsInterpretation* pMethod89FlagsInterp = &method89FlagsInterp;
+
+static constexpr FlagsInterpretation::Flag METHOD14_FLAGS[] = {
+    FlagsInterpretation::Flag(1, ENCRYPTION), // bit 0
+    FlagsInterpretation::Flag(1, LZMA_EOS_MARKER), // bit 1
+    FlagsInterpretation::Flag(1, "undefined"), // bit 2
+    FlagsInterpretation::Flag(1, DATA_DESCRIPTOR), // bit 3
+    FlagsInterpretation::Flag(1, "reserved"), // bit 4
+    FlagsInterpretation::Flag(1, PATCHED_DATA), // bit 5
+    FlagsInterpretation::Flag(1, STRONG_ENCRYPTION), // bit 6
+    FlagsInterpretation::Flag(4, "unused"), // bits 7-10
+    FlagsInterpretation::Flag(1, UTF8_ENCODING), // bit 11
+    FlagsInterpretation::Flag(1, "reserved"), // bit 12
+    FlagsInterpretation::Flag(1, MASKED_HEADER), // bit 13
+    FlagsInterpretation::Flag(1, "reserved"), // bit 14
+    FlagsInterpretation::Flag(1, "reserved") // bit 15
+};
+static FlagsInterpretation method14FlagsInterp(METHOD14_FLAGS);
+FlagsInterpretation* pMethod14FlagsInterp = &method14FlagsInterp;
+static constexpr EnumInterpretation::Enum EXTRA_FIELD_HEADER_IDS[] = {
+    EnumInterpretation::Enum(0x0001, "Zip64 extended information extra field"),
+    EnumInterpretation::Enum(0x0007, "AV Info"),
+    EnumInterpretation::Enum(0x0008, "Reserved for extended language encoding data (PFS)"),
+    EnumInterpretation::Enum(0x0009, "OS/2"),
+    EnumInterpretation::Enum(0x000A, "NTFS"),
+    EnumInterpretation::Enum(0x000C, "OpenVMS"),
+    EnumInterpretation::Enum(0x000D, "UNIX"),
+    EnumInterpretation::Enum(0x000E, "Reserved for file stream and fork descriptors"),
+    EnumInterpretation::Enum(0x000F, "Patch Descriptor"),
+    EnumInterpretation::Enum(0x0014, "PKCS#7 Store for X.509 Certificates"),
+    EnumInterpretation::Enum(0x0015, "X.509 Certificate ID and Signature for individual file"),
+    EnumInterpretation::Enum(0x0016, "X.509 Certificate ID for Central Directory"),
+    EnumInterpretation::Enum(0x0017, "Strong Encryption Header"),
+    EnumInterpretation::Enum(0x0018, "Record Management Controls"),
+    EnumInterpretation::Enum(0x0019, "PKCS#7 Encryption Recipient Certificate List"),
+    EnumInterpretation::Enum(0x0020, "Reserved for Timestamp Record"),
+    EnumInterpretation::Enum(0x0021, "Policy Decryption Key Record"),
+    EnumInterpretation::Enum(0x0022, "Smartcrypt Key Provider Record"),
+    EnumInterpretation::Enum(0x0023, "Smartcrypt Policy Key Data Record"),
+    EnumInterpretation::Enum(0x0065, "IBM S/390 (Z390), AS/400 (I400) attributes - uncompressed"),
+    EnumInterpretation::Enum(0x0066, "Reserved for IBM S/390 (Z390), AS/400 (I400) attributes - compressed"),
+    EnumInterpretation::Enum(0x07C8, "Macintosh"),
+    EnumInterpretation::Enum(0x1986, "Pixar USD header ID"),
+    EnumInterpretation::Enum(0x2605, "ZipIt Macintosh"),
+    EnumInterpretation::Enum(0x2705, "ZipIt Macintosh 1.3.5+"),
+    EnumInterpretation::Enum(0x2805, "ZipIt Macintosh 1.3.5+"),
+    EnumInterpretation::Enum(0x334D, "Info-ZIP Macintosh"),
+    EnumInterpretation::Enum(0x4154, "Tandem"),
+    EnumInterpretation::Enum(0x4341, "Acorn/SparkFS"),
+    EnumInterpretation::Enum(0x4453, "Windows NT security descriptor (binary ACL)"),
+    EnumInterpretation::Enum(0x4690, "POSZIP 4690 (reserved)"),
+    EnumInterpretation::Enum(0x4704, "VM/CMS"),
+    EnumInterpretation::Enum(0x470F, "VMS"),
+    EnumInterpretation::Enum(0x4854, "THEOS"),
+    EnumInterpretation::Enum(0x4B46, "FWKCS MD5"),
+    EnumInterpretation::Enum(0x4C41, "OS/2 access control list (text ACL)"),
+    EnumInterpretation::Enum(0x4D49, "Info-ZIP OpenVMS"),
+    EnumInterpretation::Enum(0x4D63, "Macintosh Smartzip"),
+    EnumInterpretation::Enum(0x4F4C, "Xceed original location extra field"),
+    EnumInterpretation::Enum(0x5356, "AOS/VS (ACL)"),
+    EnumInterpretation::Enum(0x5455, "extended timestamp"),
+    EnumInterpretation::Enum(0x554E, "Xceed unicode extra field"),
+    EnumInterpretation::Enum(0x5855, "Info-ZIP UNIX (original, also OS/2, NT, etc)"),
+    EnumInterpretation::Enum(0x6375, "Info-ZIP Unicode Comment Extra Field"),
+    EnumInterpretation::Enum(0x6542, "BeOS/BeBox"),
+    EnumInterpretation::Enum(0x6854, "THEOS"),
+    EnumInterpretation::Enum(0x7075, "Info-ZIP Unicode Path Extra Field"),
+    EnumInterpretation::Enum(0x7441, "AtheOS/Syllable"),
+    EnumInterpretation::Enum(0x756E, "ASi UNIX"),
+    EnumInterpretation::Enum(0x7855, "Info-ZIP UNIX (new)"),
+    EnumInterpretation::Enum(0x7875, "Info-ZIP UNIX (newer UID/GID)"),
+    EnumInterpretation::Enum(0x9901, "AE-x encryption structure"),
+    EnumInterpretation::Enum(0x9902, "unknown"),
+    EnumInterpretation::Enum(0xA11E, "Data Stream Alignment (Apache Commons-Compress)"),
+    EnumInterpretation::Enum(0xA220, "Microsoft Open Packaging Growth Hint"),
+    EnumInterpretation::Enum(0xCAFE, "Java JAR file Extra Field Header ID"),
+    EnumInterpretation::Enum(0xD935, "Andriod ZIP Alignment Extra Field"),
+    EnumInterpretation::Enum(0xE57A, "Korean ZIP code page info"),
+    EnumInterpretation::Enum(0xFD4A, "SMS/QDOS")
+};
+static_assert(EnumInterpretation::isSorted(EXTRA_FIELD_HEADER_IDS), "EXTRA_FIELD_HEADER_IDS must be sorted by value");
+static EnumInterpretation extraFieldHeaderIdInterp("unknown", IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN, EXTRA_FIELD_HEADER_IDS);
+
+static constexpr EnumInterpretation::Enum HOST_SYSTEMS[] = {
+    EnumInterpretation::Enum(0, "MS-DOS and OS/2 (FAT / VFAT / FAT32 file systems)"),
+    EnumInterpretation::Enum(1, "Amiga"),
+    EnumInterpretation::Enum(2, "OpenVMS"),
+    EnumInterpretation::Enum(3, "UNIX"),
+    EnumInterpretation::Enum(4, "VM/CMS"),
+    EnumInterpretation::Enum(5, "Atari ST"),
+    EnumInterpretation::Enum(6, "OS/2 H.P.F.S."),
+    EnumInterpretation::Enum(7, "Macintosh"),
+    EnumInterpretation::Enum(8, "Z-System"),
+    EnumInterpretation::Enum(9, "CP/M"),
+    EnumInterpretation::Enum(10, "Windows NTFS"),
+    EnumInterpretation::Enum(11, "MVS (OS/390 - Z/OS)"),
+    EnumInterpretation::Enum(12, "VSE"),
+    EnumInterpretation::Enum(13, "Acorn Risc"),
+    EnumInterpretation::Enum(14, "VFAT"),
+    EnumInterpretation::Enum(15, "alternative MVS"),
+    EnumInterpretation::Enum(16, "BeOS"),
+    EnumInterpretation::Enum(17, "Tandem"),
+    EnumInterpretation::Enum(18, "OS/400"),
+    EnumInterpretation::Enum(19, "OS X (Darwin)")
+};
+static_assert(EnumInterpretation::isSorted(HOST_SYSTEMS), "HOST_SYSTEMS must be sorted by value");
+static EnumInterpretation hostSystemInterp("Unknown", IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN, HOST_SYSTEMS);
+
+// The archive comment has no flags to mark it UTF-8
+static TextInterpretation zipCommentInterp(TEXT_CP437);
+
+// Integer fields hold no state of their own, so every node shares these
+static IntInterpretation hexIntInterp(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN);
+static IntInterpretation decimalIntInterp(IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN);
+
+// For interpretations made for one node, e.g. reading another node of the same record. They are freed with the node.
+static Node *ownedNode(const char *description, long offset, long length, Interpretation* pInterpretation)
+{
+    Node *node = new Node(description, offset, length, pInterpretation);
+    node->ownsInterpretation = true;
+    return node;
+}
+
+Node *parse(FILE *fp, EntryTable *entries)
+{
+    IncrementalParser parser(fp, fp, NULL, entries);
+    while (parser.step())
+    {}
+
+    return parser.getRoot();
+}
+
+void parse(FILE *fp, TreeVisitor& visitor)
+{
+    IncrementalParser parser(fp, fp, &visitor);
+    while (parser.step())
+    {}
+
+    deleteNode(parser.getRoot());
+}
+
+IncrementalParser::IncrementalParser(FILE *fp, FILE *dataFp, mutex *treeLock, EntryTable *entries) :
+    fp(fp), treeLock(treeLock), visitor(NULL), entries(entries), started(false), offset(0), centralDirectory(NULL), centralDirectoryLen(0), done(false), centralSizesRead(false)
+{
+    // Length is updated as records are linked in
+    root = new Node("Zip File", 0L, 0L, NULL);
+    new DataNode(root, new FileAccessor(dataFp));
+
+    staging = new Node("", 0L, 0L, NULL);
+}
+
+IncrementalParser::IncrementalParser(FILE *fp, FILE *dataFp, TreeVisitor *visitor) :
+    fp(fp), treeLock(NULL), visitor(visitor), entries(NULL), started(false), offset(0), centralDirectory(NULL), centralDirectoryLen(0), done(false), centralSizesRead(false)
 {
-    // Length will be updated at the end of the function
-    Node *output = new Node("Zip File", 0L, 0L, NULL);
+    // Length is updated as records are linked in
+    root = new Node("Zip File", 0L, 0L, NULL);
+    new DataNode(root, new FileAccessor(dataFp));
+
+    staging = new Node("", 0L, 0L, NULL);
+}
 
-    char signatureBuffer[4];
+IncrementalParser::~IncrementalParser()
+{
+    if (visitor != NULL && centralDirectory != NULL)
+    { deleteNode(centralDirectory); }
+
+    deleteNode(staging);
+}
 
-    long offset = 0;
+bool IncrementalParser::step()
+{
+    if (done)
+    { return false; }
 
-    while (! feof(fp))
+    if (visitor != NULL && !started)
     {
-        peek(fp, 4, signatureBuffer);
+        long pos = ftell(fp);
+        visitor->enter(root, 0, getDataNode(root)->accessor->getSize());
+        fseek(fp, pos, SEEK_SET);
+        started = true;
+    }
 
-        if (memcmp(signatureBuffer, "\x50\x4b\x03\x04", 4) == 0)
-        {
-            offset += readLocalFileHeader(fp, offset, output);
-            continue;
-        }
+    char signatureBuffer[4] = {0};
+    if (! feof(fp))
+    { peek(fp, 4, signatureBuffer); }
 
+    if (centralDirectory != NULL)
+    {
         if (memcmp(signatureBuffer, "\x50\x4b\x01\x02", 4) == 0)
         {
-            offset += readCentralDirectory(fp, offset, output);
-            continue;
+            centralDirectoryLen += readCentralDirectoryFileHeader(fp, centralDirectoryLen, staging);
+            link(centralDirectory);
+            return true;
         }
 
         if (memcmp(signatureBuffer, "\x50\x4b\x05\x06", 4) == 0)
         {
-            offset += readCentralDirectory(fp, offset, output);
-            continue;
+            centralDirectoryLen += readEndOfCentralDirectoryRecord(fp, centralDirectoryLen, staging);
+            link(centralDirectory);
+            return true;
         }
 
-        // Section unrecognized
-        break;
+        endCentralDirectory();
     }
 
-    output->segments[0].length = offset;
+    if (memcmp(signatureBuffer, "\x50\x4b\x03\x04", 4) == 0)
+    {
+        // A streamed entry leaves its sizes to a data descriptor after the data. The central directory has them too.
+        uint16_t flags = 0;
+        uint32_t compressedSize = 0;
+        peekRelative(fp, 0x6, 2, (char *)&flags);
+        peekRelative(fp, 0x12, 4, (char *)&compressedSize);
+
+        bool hasDataDescriptor = (flags & FLAG_DATA_DESCRIPTOR) != 0;
+        if (hasDataDescriptor && compressedSize == 0)
+        { hasDataDescriptor = findCentralCompressedSize(offset, compressedSize); }  // Otherwise where the data ends is unknown
 
-    DataNode* dn = new DataNode(output, new FileAccessor(fp));
+        offset += readLocalFileHeader(fp, offset, compressedSize, staging);
 
-    return output;
+        // Some writers set the flag without writing one
+        if (hasDataDescriptor)
+        {
+            char nextSignature[4] = {0};
+            peek(fp, 4, nextSignature);
+            hasDataDescriptor = memcmp(nextSignature, "\x50\x4b\x03\x04", 4) != 0 && memcmp(nextSignature, "\x50\x4b\x01\x02", 4) != 0
+                && memcmp(nextSignature, "\x50\x4b\x05\x06", 4) != 0;
+        }
+        if (hasDataDescriptor)
+        { offset += readDataDescriptor(fp, offset, staging); }
+        link(root);
+        return true;
+    }
+
+    // Its records are linked in one at a time as they are read
+    if (memcmp(signatureBuffer, "\x50\x4b\x01\x02", 4) == 0 || memcmp(signatureBuffer, "\x50\x4b\x05\x06", 4) == 0)
+    {
+        // A visitor is told its length up front, so the records are skimmed for it. It is never linked in.
+        if (visitor != NULL)
+        {
+            centralDirectory = new Node("Central Directory", offset, skimCentralDirectory(), NULL);
+            centralDirectory->parent = staging;
+            new DataNode(centralDirectory, getDataNode(root)->accessor->subset(offset, centralDirectory->segments[0].length));
+            long pos = ftell(fp);
+            visitor->enter(centralDirectory, offset, centralDirectory->segments[0].length);
+            fseek(fp, pos, SEEK_SET);
+            centralDirectoryLen = 0;
+            return true;
+        }
+
+        addChildNode(staging, new Node("Central Directory", offset, 0, NULL));
+        centralDirectoryLen = 0;
+        link(root);
+        centralDirectory = root->lastChild;
+        return true;
+    }
+
+    // End of file, or section unrecognized
+    if (visitor != NULL)
+    { visitor->leave(root); }
+
+    done = true;
+    return false;
 }
 
-long readCentralDirectory(FILE *fp, long parentOffset, Node *parentNode)
+// Moves the record read under staging to parent
+void IncrementalParser::link(Node *parent)
 {
-    Node *centralDirectory = new Node("Central Directory", parentOffset, 0, NULL);
+    if (visitor != NULL)
+    {
+        visitRecords(parent);
+        return;
+    }
 
-    char signatureBuffer[4];
+    unique_lock<mutex> guard;
+    if (treeLock != NULL)
+    { guard = unique_lock<mutex>(*treeLock); }
 
-    long offset = 0;
+    Node *first = staging->firstChild;
+    Node *child = first;
+    while (child != NULL)
+    {
+        Node *next = child->nextSibling;
+        child->nextSibling = child->prevSibling = NULL;
+        addChildNode(parent, child);
+        child = next;
+    }
+    staging->firstChild = staging->lastChild = NULL;
+
+    // The dependency graph holds the nodes linked in so far
+    getFormatCache(root)->treeChanged();
+
+    if (centralDirectory != NULL)
+    { centralDirectory->segments[0].length = centralDirectoryLen; }
+    root->segments[0].length = offset + centralDirectoryLen;
+
+    if (entries == NULL || parent != centralDirectory)
+    { return; }
 
-    while (! feof(fp))
+    // Reading the fields may wait on the file, which may be the one being parsed
+    if (guard.owns_lock())
+    { guard.unlock(); }
+
+    long pos = ftell(fp);
+    for (child = first; child != NULL; child = child->nextSibling)
     {
-        peek(fp, 4, signatureBuffer);
+        if (strcmp(child->description, "Central Directory File Header") == 0)
+        { entries->add(child); }
+    }
+    fseek(fp, pos, SEEK_SET);
+}
 
+void IncrementalParser::endCentralDirectory()
+{
+    if (visitor != NULL)
+    {
+        visitor->leave(centralDirectory);
+        getFormatCache(staging)->invalidateAll();
+        deleteNode(centralDirectory);
+
+        offset += centralDirectoryLen;
+        centralDirectory = NULL;
+        centralDirectoryLen = 0;
+        return;
+    }
+
+    unique_lock<mutex> guard;
+    if (treeLock != NULL)
+    { guard = unique_lock<mutex>(*treeLock); }
+
+    // A data node made while it was still growing is cut short
+    DataNode *dataNode = centralDirectory->dataNode;
+    if (dataNode != NULL)
+    {
+        delete dataNode->accessor;
+        dataNode->accessor = getDataNode(root)->accessor->subset(centralDirectory->segments[0].offset, centralDirectoryLen);
+    }
+
+    offset += centralDirectoryLen;
+    centralDirectory = NULL;
+    centralDirectoryLen = 0;
+}
+
+// Hands the record read under staging to the visitor as if it were under parent, then frees it
+void IncrementalParser::visitRecords(Node *parent)
+{
+    long parentOffset = absoluteOffset(parent);
+
+    // The visitor may read the nodes' bytes, and the data file may be the one being parsed
+    long pos = ftell(fp);
+
+    for (Node *child = staging->firstChild; child != NULL; child = child->nextSibling)
+    {
+        placeNode(child, parentOffset);
+        new DataNode(child, getDataNode(root)->accessor->subset(absoluteOffset(child), child->segments[0].length));
+        visit(child);
+    }
+    fseek(fp, pos, SEEK_SET);
+
+    // Values are cached by node, and the nodes are about to be freed
+    getFormatCache(staging)->invalidateAll();
+
+    Node *child = staging->firstChild;
+    while (child != NULL)
+    {
+        Node *next = child->nextSibling;
+        deleteNode(child);
+        child = next;
+    }
+    staging->firstChild = staging->lastChild = NULL;
+}
+
+void IncrementalParser::visit(Node *node)
+{
+    long offset = absoluteOffset(node);
+    long length = getDataNode(node)->accessor->getSize();
+    if (node->firstChild == NULL)
+    {
+        visitor->field(node, offset, length);
+        return;
+    }
+
+    visitor->enter(node, offset, length);
+    for (Node *child = node->firstChild; child != NULL; child = child->nextSibling)
+    {
+        visit(child);
+    }
+    visitor->leave(node);
+}
+
+// Returns the length of the central directory starting at the cursor, reading only the lengths of its records. The
+// records recognized are those step() reads while in the central directory.
+long IncrementalParser::skimCentralDirectory()
+{
+    long startPos = ftell(fp);
+    long len = 0;
+
+    while (1)
+    {
+        char signatureBuffer[4] = {0};
+        if (! feof(fp))
+        { peek(fp, 4, signatureBuffer); }
+
+        long recordLen;
         if (memcmp(signatureBuffer, "\x50\x4b\x01\x02", 4) == 0)
         {
-            offset += readCentralDirectoryFileHeader(fp, offset, centralDirectory);
-            continue;
+            uint16_t fileNameLen = 0, extraFieldLen = 0, fileCommentLen = 0;
+            peekRelative(fp, 0x1c, 2, (char *)&fileNameLen);
+            peekRelative(fp, 0x1e, 2, (char *)&extraFieldLen);
+            peekRelative(fp, 0x20, 2, (char *)&fileCommentLen);
+            recordLen = 0x2e + fileNameLen + extraFieldLen + fileCommentLen;
+        } else if (memcmp(signatureBuffer, "\x50\x4b\x05\x06", 4) == 0) {
+            uint16_t commentLen = 0;
+            peekRelative(fp, 0x14, 2, (char *)&commentLen);
+            recordLen = 0x16 + commentLen;
+        } else {
+            break;
         }
 
-        if (memcmp(signatureBuffer, "\x50\x4b\x05\x06", 4) == 0)
+        fseek(fp, recordLen, SEEK_CUR);
+        len += recordLen;
+    }
+
+    fseek(fp, startPos, SEEK_SET);
+    return len;
+}
+
+// Looks up the compressed size the central directory gives the entry whose local header is at localHeaderOffset.
+// The central directory is found from the end of the file and read on first use. Returns false if it does not list
+// the entry.
+bool IncrementalParser::findCentralCompressedSize(long localHeaderOffset, uint32_t& out)
+{
+    if (! centralSizesRead)
+    {
+        centralSizesRead = true;
+        long startPos = ftell(fp);
+
+        // The end of central directory record comes last, followed only by a comment of up to 64 KB
+        fseek(fp, 0, SEEK_END);
+        long fileSize = ftell(fp);
+        long tailLen = (fileSize < 0x16 + 0xFFFF) ? fileSize : 0x16 + 0xFFFF;
+        vector<char> tail(tailLen);
+        fseek(fp, fileSize - tailLen, SEEK_SET);
+        tailLen = read(fp, tailLen, tail.data());
+
+        for (long recordIdx = tailLen - 0x16; recordIdx >= 0; recordIdx--)
         {
-            offset += readEndOfCentralDirectoryRecord(fp, offset, centralDirectory);
-            continue;
+            if (memcmp(&tail[recordIdx], "\x50\x4b\x05\x06", 4) != 0)
+            { continue; }
+
+            uint32_t centralDirectoryOffset;
+            memcpy(&centralDirectoryOffset, &tail[recordIdx + 0x10], 4);
+            fseek(fp, centralDirectoryOffset, SEEK_SET);
+
+            while (1)
+            {
+                char signatureBuffer[4] = {0};
+                if (! feof(fp))
+                { peek(fp, 4, signatureBuffer); }
+                if (memcmp(signatureBuffer, "\x50\x4b\x01\x02", 4) != 0)
+                { break; }
+
+                uint32_t compressedSize = 0, headerOffset = 0;
+                uint16_t fileNameLen = 0, extraFieldLen = 0, fileCommentLen = 0;
+                peekRelative(fp, 0x14, 4, (char *)&compressedSize);
+                peekRelative(fp, 0x2a, 4, (char *)&headerOffset);
+                peekRelative(fp, 0x1c, 2, (char *)&fileNameLen);
+                peekRelative(fp, 0x1e, 2, (char *)&extraFieldLen);
+                peekRelative(fp, 0x20, 2, (char *)&fileCommentLen);
+                centralSizes[headerOffset] = compressedSize;
+
+                fseek(fp, 0x2e + fileNameLen + extraFieldLen + fileCommentLen, SEEK_CUR);
+            }
+            break;
         }
 
-        // Section unrecognized
-        break;
+        clearerr(fp);
+        fseek(fp, startPos, SEEK_SET);
     }
 
-    addChildNode(parentNode, centralDirectory);
+    map<long, uint32_t>::iterator found = centralSizes.find(localHeaderOffset);
+    if (found == centralSizes.end())
+    { return false; }
 
-    centralDirectory->segments[0].length = offset;
-
-    return offset;
+    out = found->second;
+    return true;
 }
 
-long readLocalFileHeader(FILE *fp, long parentOffset, Node *parentNode)
+// compressedSize is the length of the data following the header, which the header itself may leave as 0
+long readLocalFileHeader(FILE *fp, long parentOffset, uint32_t compressedSize, Node *parentNode)
 {
     uint16_t fileNameLen;
     uint16_t extraFieldLen;
-    uint32_t compressedSize;
 
     peekRelative(fp, 0x1a, 2, (char *)&fileNameLen);    // TODO: Error checking
     peekRelative(fp, 0x1c, 2, (char *)&extraFieldLen);    // TODO: Error checking
-    peekRelative(fp, 0x12, 4, (char *)&compressedSize);    // TODO: Error checking
 
     int localFileHeaderLen = 0x1e + fileNameLen + extraFieldLen;
 
-    Node *filenameNode = new Node("File name", 0x1E, fileNameLen, Interpretation::ascii);
-    Node *headerNode = new Node("Local File Header", parentOffset, localFileHeaderLen, new NodeInterpretation(filenameNode));
+    // The flags say how the file name is encoded
+    Node *compressionNode = new Node("Compression method", 0x8, 0x2, compressionInterpretation);
+    Node *flagsNode = ownedNode("Flags", 0x6, 0x2, new ConditionalInterpretation(compressionNode, pDefaultFlagsInterp, {
+        ConditionalInterpretation::Condition(6, pMethod6FlagsInterp),
+        ConditionalInterpretation::Condition(8, pMethod89FlagsInterp),
+        ConditionalInterpretation::Condition(9, pMethod89FlagsInterp),
+        ConditionalInterpretation::Condition(14, pMethod14FlagsInterp)
+    }));
+    Node *filenameNode = ownedNode("File name", 0x1E, fileNameLen, new TextInterpretation(flagsNode));
+    Node *headerNode = ownedNode("Local File Header", parentOffset, localFileHeaderLen, new NodeInterpretation(filenameNode));
     addChildNode(parentNode, headerNode);
-    Node *dataNode = new Node("File Data", parentOffset + localFileHeaderLen, compressedSize, new NodeInterpretation(filenameNode));
+    Node *dataNode = ownedNode("File Data", parentOffset + localFileHeaderLen, compressedSize, new NodeInterpretation(filenameNode));
     addChildNode(parentNode, dataNode);
 
     addChildNode(headerNode,
         new Node("Signature", 0x0, 0x4, Interpretation::hex));
     addChildNode(headerNode,
-        new Node("Version", 0x4, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
-    Node *compressionNode = new Node("Compression method", 0x8, 0x2, compressionInterpretation);
-    addChildNode(headerNode,
-        new Node("Flags", 0x6, 0x2, new ConditionalInterpretation(compressionNode, pDefaultFlagsInterp, {
-            ConditionalInterpretation::Condition(6, pMethod6FlagsInterp),
-            ConditionalInterpretation::Condition(8, pMethod89FlagsInterp),
-            ConditionalInterpretation::Condition(9, pMethod89FlagsInterp),
-            ConditionalInterpretation::Condition(14, pMethod14FlagsInterp)
-        })));
+        new Node("Version", 0x4, 0x2, &hexIntInterp));
+    addChildNode(headerNode, flagsNode);
     addChildNode(headerNode,
         compressionNode);
     addChildNode(headerNode,
@@ -232,13 +653,13 @@ long readLocalFileHeader(FILE *fp, long parentOffset, Node *parentNode)
     addChildNode(headerNode,
         new Node("CRC-32 checksum", 0xE, 0x4, Interpretation::hex));
     addChildNode(headerNode,
-        new Node("Compressed size", 0x12, 0x4, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Compressed size", 0x12, 0x4, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("Uncompressed size", 0x16, 0x4, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Uncompressed size", 0x16, 0x4, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("File name length", 0x1A, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("File name length", 0x1A, 0x2, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("Extra field length", 0x1C, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Extra field length", 0x1C, 0x2, &hexIntInterp));
     addChildNode(headerNode, filenameNode);
 
     long extraFieldOffset = 0;
@@ -247,7 +668,6 @@ long readLocalFileHeader(FILE *fp, long parentOffset, Node *parentNode)
     while (extraFieldOffset < extraFieldLen)
     {
         extraFieldOffset += readExtraField(fp, extraFieldOffset, extraFieldsNode);
-        fprintf(stderr, "extraFieldOffset: %lu", extraFieldOffset);
     }
     addChildNode(headerNode, extraFieldsNode);
 
@@ -256,6 +676,35 @@ long readLocalFileHeader(FILE *fp, long parentOffset, Node *parentNode)
     return localFileHeaderLen + compressedSize;
 }
 
+long readDataDescriptor(FILE *fp, long parentOffset, Node *parentNode)
+{
+    // The signature is optional
+    char signatureBuffer[4] = {0};
+    peek(fp, 4, signatureBuffer);
+    long signatureLen = (memcmp(signatureBuffer, "\x50\x4b\x07\x08", 4) == 0) ? 0x4 : 0x0;
+
+    long dataDescriptorLen = signatureLen + 0xC;
+
+    Node *dataDescriptorNode = new Node("Data Descriptor", parentOffset, dataDescriptorLen, NULL);
+    addChildNode(parentNode, dataDescriptorNode);
+
+    if (signatureLen > 0)
+    {
+        addChildNode(dataDescriptorNode,
+            new Node("Signature", 0x0, 0x4, Interpretation::hex));
+    }
+    addChildNode(dataDescriptorNode,
+        new Node("CRC-32 checksum", signatureLen, 0x4, Interpretation::hex));
+    addChildNode(dataDescriptorNode,
+        new Node("Compressed size", signatureLen + 0x4, 0x4, &hexIntInterp));
+    addChildNode(dataDescriptorNode,
+        new Node("Uncompressed size", signatureLen + 0x8, 0x4, &hexIntInterp));
+
+    fseek(fp, dataDescriptorLen, SEEK_CUR);
+
+    return dataDescriptorLen;
+}
+
 long readExtraField(FILE *fp, long parentOffset, Node *parentNode)
 {
     uint16_t headerLen = 0x4;
@@ -263,76 +712,16 @@ long readExtraField(FILE *fp, long parentOffset, Node *parentNode)
 
     peekRelative(fp, 0x2, 2, (char *)&dataLen);	// TODO: Error checking
 
-    Node *extraFieldHeaderIdNode = new Node("Header ID", 0x0, 0x2, new EnumInterpretation("unknown", IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN, {
-        EnumInterpretation::Enum(0x0001, "Zip64 extended information extra field"),
-        EnumInterpretation::Enum(0x0007, "AV Info"),
-        EnumInterpretation::Enum(0x0008, "Reserved for extended language encoding data (PFS)"),
-        EnumInterpretation::Enum(0x0009, "OS/2"),
-        EnumInterpretation::Enum(0x000A, "NTFS"),
-        EnumInterpretation::Enum(0x000C, "OpenVMS"),
-        EnumInterpretation::Enum(0x000D, "UNIX"),
-        EnumInterpretation::Enum(0x000E, "Reserved for file stream and fork descriptors"),
-        EnumInterpretation::Enum(0x000F, "Patch Descriptor"),
-        EnumInterpretation::Enum(0x0014, "PKCS#7 Store for X.509 Certificates"),
-        EnumInterpretation::Enum(0x0015, "X.509 Certificate ID and Signature for individual file"),
-        EnumInterpretation::Enum(0x0016, "X.509 Certificate ID for Central Directory"),
-        EnumInterpretation::Enum(0x0017, "Strong Encryption Header"),
-        EnumInterpretation::Enum(0x0018, "Record Management Controls"),
-        EnumInterpretation::Enum(0x0019, "PKCS#7 Encryption Recipient Certificate List"),
-        EnumInterpretation::Enum(0x0020, "Reserved for Timestamp Record"),
-        EnumInterpretation::Enum(0x0021, "Policy Decryption Key Record"),
-        EnumInterpretation::Enum(0x0022, "Smartcrypt Key Provider Record"),
-        EnumInterpretation::Enum(0x0023, "Smartcrypt Policy Key Data Record"),
-        EnumInterpretation::Enum(0x0065, "IBM S/390 (Z390), AS/400 (I400) attributes - uncompressed"),
-        EnumInterpretation::Enum(0x0066, "Reserved for IBM S/390 (Z390), AS/400 (I400) attributes - compressed"),
-        EnumInterpretation::Enum(0x4690, "POSZIP 4690 (reserved)"),
-        EnumInterpretation::Enum(0x07C8, "Macintosh"),
-        EnumInterpretation::Enum(0x1986, "Pixar USD header ID"),
-        EnumInterpretation::Enum(0x2605, "ZipIt Macintosh"),
-        EnumInterpretation::Enum(0x2705, "ZipIt Macintosh 1.3.5+"),
-        EnumInterpretation::Enum(0x2805, "ZipIt Macintosh 1.3.5+"),
-        EnumInterpretation::Enum(0x334D, "Info-ZIP Macintosh"),
-        EnumInterpretation::Enum(0x4154, "Tandem"),
-        EnumInterpretation::Enum(0x4341, "Acorn/SparkFS"),
-        EnumInterpretation::Enum(0x4453, "Windows NT security descriptor (binary ACL)"),
-        EnumInterpretation::Enum(0x4704, "VM/CMS"),
-        EnumInterpretation::Enum(0x470F, "VMS"),
-        EnumInterpretation::Enum(0x4854, "THEOS"),
-        EnumInterpretation::Enum(0x4B46, "FWKCS MD5"),
-        EnumInterpretation::Enum(0x4C41, "OS/2 access control list (text ACL)"),
-        EnumInterpretation::Enum(0x4D49, "Info-ZIP OpenVMS"),
-        EnumInterpretation::Enum(0x4D63, "Macintosh Smartzip"),
-        EnumInterpretation::Enum(0x4F4C, "Xceed original location extra field"),
-        EnumInterpretation::Enum(0x5356, "AOS/VS (ACL)"),
-        EnumInterpretation::Enum(0x5455, "extended timestamp"),
-        EnumInterpretation::Enum(0x554E, "Xceed unicode extra field"),
-        EnumInterpretation::Enum(0x5855, "Info-ZIP UNIX (original, also OS/2, NT, etc)"),
-        EnumInterpretation::Enum(0x6375, "Info-ZIP Unicode Comment Extra Field"),
-        EnumInterpretation::Enum(0x6542, "BeOS/BeBox"),
-        EnumInterpretation::Enum(0x6854, "THEOS"),
-        EnumInterpretation::Enum(0x7075, "Info-ZIP Unicode Path Extra Field"),
-        EnumInterpretation::Enum(0x7441, "AtheOS/Syllable"),
-        EnumInterpretation::Enum(0x756E, "ASi UNIX"),
-        EnumInterpretation::Enum(0x7855, "Info-ZIP UNIX (new)"),
-        EnumInterpretation::Enum(0x7875, "Info-ZIP UNIX (newer UID/GID)"),
-        EnumInterpretation::Enum(0xA11E, "Data Stream Alignment (Apache Commons-Compress)"),
-        EnumInterpretation::Enum(0xA220, "Microsoft Open Packaging Growth Hint"),
-        EnumInterpretation::Enum(0xCAFE, "Java JAR file Extra Field Header ID"),
-        EnumInterpretation::Enum(0xD935, "Andriod ZIP Alignment Extra Field"),
-        EnumInterpretation::Enum(0xE57A, "Korean ZIP code page info"),
-        EnumInterpretation::Enum(0xFD4A, "SMS/QDOS"),
-        EnumInterpretation::Enum(0x9901, "AE-x encryption structure"),
-        EnumInterpretation::Enum(0x9902, "unknown")
-    }));
+    Node *extraFieldHeaderIdNode = new Node("Header ID", 0x0, 0x2, &extraFieldHeaderIdInterp);
 
-    Node *extraFieldNode = new Node("Extra Field", parentOffset, headerLen + dataLen, new NodeInterpretation(extraFieldHeaderIdNode));
+    Node *extraFieldNode = ownedNode("Extra Field", parentOffset, headerLen + dataLen, new NodeInterpretation(extraFieldHeaderIdNode));
     addChildNode(parentNode, extraFieldNode);
 
     Node *extraFieldHeaderNode = new Node("Extra field header", 0x0, headerLen, Interpretation::hex);
     addChildNode(extraFieldNode, extraFieldHeaderNode);
     addChildNode(extraFieldHeaderNode, extraFieldHeaderIdNode);
     addChildNode(extraFieldHeaderNode,
-        new Node("Data size", 0x2, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Data size", 0x2, 0x2, &hexIntInterp));
     addChildNode(extraFieldNode, // TODO: Break down data
         new Node("Extra field data", headerLen, dataLen, Interpretation::hex));
 
@@ -354,51 +743,31 @@ long readCentralDirectoryFileHeader(FILE *fp, long parentOffset, Node *parentNod
 
     int centralDirectoryFileHeaderLen = 0x2e + fileNameLen + extraFieldLen + fileCommentLen;
 
-    Node *filenameNode = new Node("File name", 0x2E, fileNameLen, Interpretation::ascii);
+    // The flags say how the file name and comment are encoded
+    Node *compressionNode = new Node("Compression method", 0xA, 0x2, compressionInterpretation);
+    Node *flagsNode = ownedNode("Flags", 0x8, 0x2, new ConditionalInterpretation(compressionNode, pDefaultFlagsInterp, {
+        ConditionalInterpretation::Condition(6, pMethod6FlagsInterp),
+        ConditionalInterpretation::Condition(8, pMethod89FlagsInterp),
+        ConditionalInterpretation::Condition(9, pMethod89FlagsInterp),
+        ConditionalInterpretation::Condition(14, pMethod14FlagsInterp)
+    }));
+    Node *filenameNode = ownedNode("File name", 0x2E, fileNameLen, new TextInterpretation(flagsNode));
 
-    Node *headerNode = new Node("Central Directory File Header", parentOffset, centralDirectoryFileHeaderLen, new NodeInterpretation(filenameNode));
+    Node *headerNode = ownedNode("Central Directory File Header", parentOffset, centralDirectoryFileHeaderLen, new NodeInterpretation(filenameNode));
     addChildNode(parentNode, headerNode);
 
     addChildNode(headerNode,
         new Node("Signature", 0x0, 0x4, Interpretation::hex));
     Node *zipSpecVersionNode = new Node("ZIP specification version", 0x0, 0x1, Interpretation::hex); // TODO: The value/10 indicates the major version number, and the value mod 10 is the minor version number.  
-    Node *versionMadeByNode = new Node("Version made by", 0x1, 0x1, new EnumInterpretation("Unknown", IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN, {
-            EnumInterpretation::Enum(0, "MS-DOS and OS/2 (FAT / VFAT / FAT32 file systems)"),
-            EnumInterpretation::Enum(1, "Amiga"),
-            EnumInterpretation::Enum(2, "OpenVMS"),
-            EnumInterpretation::Enum(3, "UNIX"),
-            EnumInterpretation::Enum(4, "VM/CMS"),
-            EnumInterpretation::Enum(5, "Atari ST"),
-            EnumInterpretation::Enum(6, "OS/2 H.P.F.S."),
-            EnumInterpretation::Enum(7, "Macintosh"),
-            EnumInterpretation::Enum(8, "Z-System"),
-            EnumInterpretation::Enum(9, "CP/M"),
-            EnumInterpretation::Enum(10, "Windows NTFS"),
-            EnumInterpretation::Enum(11, "MVS (OS/390 - Z/OS)"),
-            EnumInterpretation::Enum(12, "VSE"),
-            EnumInterpretation::Enum(13, "Acorn Risc"),
-            EnumInterpretation::Enum(14, "VFAT"),
-            EnumInterpretation::Enum(15, "alternative MVS"),
-            EnumInterpretation::Enum(16, "BeOS"),
-            EnumInterpretation::Enum(17, "Tandem"),
-            EnumInterpretation::Enum(18, "OS/400"),
-            EnumInterpretation::Enum(19, "OS X (Darwin)")
-        }));
+    Node *versionMadeByNode = new Node("Version made by", 0x1, 0x1, &hostSystemInterp);
     Node *versionNode = new Node("Version", 0x4, 0x2, Interpretation::hex);
     addChildNode(versionNode, zipSpecVersionNode);
     addChildNode(versionNode, versionMadeByNode);
     addChildNode(headerNode, versionNode);
         //new Node("Version", 0x4, 0x2, Interpretation::hex)); // TODO: This can be broken down more
     addChildNode(headerNode,
-        new Node("Version needed", 0x6, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
-    Node *compressionNode = new Node("Compression method", 0xA, 0x2, compressionInterpretation);
-    addChildNode(headerNode,
-        new Node("Flags", 0x8, 0x2, new ConditionalInterpretation(compressionNode, pDefaultFlagsInterp, {
-            ConditionalInterpretation::Condition(6, pMethod6FlagsInterp),
-            ConditionalInterpretation::Condition(8, pMethod89FlagsInterp),
-            ConditionalInterpretation::Condition(9, pMethod89FlagsInterp),
-            ConditionalInterpretation::Condition(14, pMethod14FlagsInterp)
-        })));
+        new Node("Version needed", 0x6, 0x2, &hexIntInterp));
+    addChildNode(headerNode, flagsNode);
     addChildNode(headerNode, compressionNode);
     addChildNode(headerNode,
         new Node("File modification time", 0xC, 0x2, Interpretation::msdosTime));
@@ -407,28 +776,28 @@ long readCentralDirectoryFileHeader(FILE *fp, long parentOffset, Node *parentNod
     addChildNode(headerNode,
         new Node("CRC-32 checksum", 0x10, 0x4, Interpretation::hex));
     addChildNode(headerNode,
-        new Node("Compressed size", 0x14, 0x4, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Compressed size", 0x14, 0x4, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("Uncompressed size", 0x18, 0x4, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Uncompressed size", 0x18, 0x4, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("File name length", 0x1C, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("File name length", 0x1C, 0x2, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("Extra field length", 0x1E, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Extra field length", 0x1E, 0x2, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("File comment length", 0x20, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("File comment length", 0x20, 0x2, &hexIntInterp));
     addChildNode(headerNode,
-        new Node("Disk # start", 0x22, 0x2, new IntInterpretation(IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Disk # start", 0x22, 0x2, &decimalIntInterp));
     addChildNode(headerNode,
         new Node("Internal attributes", 0x24, 0x2, Interpretation::hex));
     addChildNode(headerNode,
         new Node("External attributes", 0x26, 0x4, Interpretation::hex));
     addChildNode(headerNode,
-        new Node("Offset of local header", 0x2A, 0x4, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Offset of local header", 0x2A, 0x4, &hexIntInterp));
     addChildNode(headerNode, filenameNode);
     addChildNode(headerNode,
         new Node("Extra field", 0x2E + fileNameLen, extraFieldLen, Interpretation::hex)); // TODO: This can be broken down more
     addChildNode(headerNode,
-        new Node("File comment", 0x2E + fileNameLen + extraFieldLen, fileCommentLen, Interpretation::ascii));
+        ownedNode("File comment", 0x2E + fileNameLen + extraFieldLen, fileCommentLen, new TextInterpretation(flagsNode)));
 
     fseek(fp, centralDirectoryFileHeaderLen, SEEK_CUR);
 
@@ -449,21 +818,21 @@ long readEndOfCentralDirectoryRecord(FILE *fp, long parentOffset, Node *parentNo
     addChildNode(eocdrNode,
         new Node("Signature", 0x0, 0x4, Interpretation::hex));
     addChildNode(eocdrNode,
-        new Node("Disk #", 0x4, 0x2, new IntInterpretation(IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Disk #", 0x4, 0x2, &decimalIntInterp));
     addChildNode(eocdrNode,
-        new Node("Disk # w/ central directory", 0x6, 0x2, new IntInterpretation(IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Disk # w/ central directory", 0x6, 0x2, &decimalIntInterp));
     addChildNode(eocdrNode,
-        new Node("Disk entries", 0x8, 0x2, new IntInterpretation(IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Disk entries", 0x8, 0x2, &decimalIntInterp));
     addChildNode(eocdrNode,
-        new Node("Total entries", 0xA, 0x2, new IntInterpretation(IntInterpretation::OPT_EXCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Total entries", 0xA, 0x2, &decimalIntInterp));
     addChildNode(eocdrNode,
-        new Node("Central directory size", 0xC, 0x4, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Central directory size", 0xC, 0x4, &hexIntInterp));
     addChildNode(eocdrNode,
-        new Node("Offset of central directory from starting disk", 0x10, 0x4, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Offset of central directory from starting disk", 0x10, 0x4, &hexIntInterp));
     addChildNode(eocdrNode,
-        new Node("Zip file comment length", 0x14, 0x2, new IntInterpretation(IntInterpretation::OPT_INCL_HEX | IntInterpretation::OPT_LITTLE_ENDIAN)));
+        new Node("Zip file comment length", 0x14, 0x2, &hexIntInterp));
     addChildNode(eocdrNode,
-        new Node("Zip file comment", 0x16, commentLen, Interpretation::ascii));
+        new Node("Zip file comment", 0x16, commentLen, &zipCommentInterp));
     fseek(fp, endOfCentralDirectoryRecordLen, SEEK_CUR);
 
     return endOfCentralDirectoryRecordLen;
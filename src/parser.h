@@ -2,9 +2,87 @@
 #define BINVIEW_PARSER
 
 #include <stdio.h>
+#include <inttypes.h>
+
+#include <map>
+#include <mutex>
 
 #include "hierarchy.h"
 
-Node *parse(FILE *fp);
+using namespace std;
+
+/* Receives a parse as events instead of a tree, for when the tree would not fit in memory. See IncrementalParser.
+ *
+ * Nodes come in depth-first order: enter() for a node with children, which follow until its leave(), and field() for
+ * a node without. offset is from the start of the file. The node can be formatted with formatNode() and read through
+ * getDataNode(), but only during the call: each record is freed once its events are out.
+ */
+class TreeVisitor
+{
+public:
+    virtual ~TreeVisitor() {}
+
+    virtual void enter(Node *node, long offset, long length) = 0;
+    virtual void field(Node *node, long offset, long length) = 0;
+    virtual void leave(Node *node) = 0;
+};
+
+class EntryTable;
+
+// When entries is given, each central directory file header is added to it as it is linked in
+Node *parse(FILE *fp, EntryTable *entries = NULL);
+
+// Parses the whole file into events for visitor, holding no more than one record at a time
+void parse(FILE *fp, TreeVisitor& visitor);
+
+/* Parses a zip file one record at a time, so the tree can be shown while it grows.
+ *
+ * Each record is read into a tree of its own and only then linked in. When treeLock is given it is held for the linking
+ * and nowhere else, so readers holding it never wait on the file.
+ *
+ * Given an entry table, each central directory file header is added to it once linked in, outside of treeLock.
+ *
+ * Given a visitor instead, each record is handed to it and then freed rather than linked in, so the root never gets
+ * children and memory stays the same for any number of records.
+ */
+class IncrementalParser
+{
+public:
+    // Records are read from fp. The nodes' bytes are read from dataFp, which may be the same file.
+    IncrementalParser(FILE *fp, FILE *dataFp, mutex *treeLock = NULL, EntryTable *entries = NULL);
+    IncrementalParser(FILE *fp, FILE *dataFp, TreeVisitor *visitor);
+    ~IncrementalParser();
+
+    Node *getRoot() { return root; }
+
+    // Parses and links the next record. Returns false once there are no more recognized records.
+    bool step();
+    bool isDone() { return done; }
+
+private:
+    FILE *fp;
+    mutex *treeLock;
+    TreeVisitor *visitor;
+    EntryTable *entries;
+    bool started;               // Whether the root was entered
+    Node *root;
+    Node *staging;              // Parent of the record being read, until it is linked in
+
+    long offset;                // Where the next top-level record starts
+    Node *centralDirectory;     // The central directory being read, or NULL
+    long centralDirectoryLen;
+    bool done;
+
+    map<long, uint32_t> centralSizes;   // Compressed sizes by local header offset, for streamed entries
+    bool centralSizesRead;
+
+    void link(Node *parent);
+    void endCentralDirectory();
+
+    void visitRecords(Node *parent);
+    void visit(Node *node);
+    long skimCentralDirectory();
+    bool findCentralCompressedSize(long localHeaderOffset, uint32_t& out);
+};
 
 #endif
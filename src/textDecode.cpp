@@ -0,0 +1,240 @@
+#include "textDecode.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BINVIEW_TEXT_AVX2
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BINVIEW_TEXT_SSE2
+#endif
+
+// Code points of CP437 bytes 0x80-0xFF
+static const uint16_t CP437_HIGH[128] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+};
+
+static inline bool isPrintableAscii(byte value)
+{
+    return value >= 0x20 && value < 0x7F;
+}
+
+static size_t asciiRunScalar(const byte* src, size_t len, bool printableOnly)
+{
+    size_t runLen = 0;
+    while (runLen < len && (printableOnly ? isPrintableAscii(src[runLen]) : src[runLen] < 0x80))
+    { runLen++; }
+    return runLen;
+}
+
+#ifdef BINVIEW_TEXT_SSE2
+// Scans 16 bytes at a time. Returns how many leading bytes are ASCII (printable ASCII with printableOnly set).
+static size_t asciiRunSse2(const byte* src, size_t len, bool printableOnly)
+{
+    size_t runLen = 0;
+    for (; runLen + 16 <= len; runLen += 16)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i*)(src + runLen));
+
+        // Bytes from 0x80 up compare as negative, so the lower bound rules them out too
+        int mask = printableOnly
+            ? _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(in, _mm_set1_epi8(0x7F))))
+            : ~_mm_movemask_epi8(in) & 0xFFFF;
+        if (mask != 0xFFFF)
+        { return runLen + __builtin_ctz(~mask); }
+    }
+    return runLen;
+}
+#endif
+
+#ifdef BINVIEW_TEXT_AVX2
+// As asciiRunSse2, 32 bytes at a time
+__attribute__((target("avx2")))
+static size_t asciiRunAvx2(const byte* src, size_t len, bool printableOnly)
+{
+    size_t runLen = 0;
+    for (; runLen + 32 <= len; runLen += 32)
+    {
+        __m256i in = _mm256_loadu_si256((const __m256i*)(src + runLen));
+
+        uint32_t mask = printableOnly
+            ? _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8(0x1F)), _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7F), in)))
+            : ~_mm256_movemask_epi8(in);
+        if (mask != 0xFFFFFFFF)
+        { return runLen + __builtin_ctz(~mask); }
+    }
+    return runLen;
+}
+
+static bool hasAvx2()
+{
+    static bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+// The vector kernels stop short of their last full block only when they find a byte outside the run
+static size_t asciiRun(const byte* src, size_t len, bool printableOnly)
+{
+    size_t runLen = 0;
+
+#ifdef BINVIEW_TEXT_AVX2
+    if (len >= 32 && hasAvx2())
+    {
+        runLen = asciiRunAvx2(src, len, printableOnly);
+        if (runLen < (len & ~(size_t)31))
+        { return runLen; }
+    }
+#endif
+
+#ifdef BINVIEW_TEXT_SSE2
+    size_t sseLen = asciiRunSse2(src + runLen, len - runLen, printableOnly);
+    if (sseLen < ((len - runLen) & ~(size_t)15))
+    { return runLen + sseLen; }
+    runLen += sseLen;
+#endif
+
+    return runLen + asciiRunScalar(src + runLen, len - runLen, printableOnly);
+}
+
+static void appendEscaped(byte value, string& out)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char escaped[4] = {'\\', 'x', digits[value >> 4], digits[value & 0xF]};
+    out.append(escaped, 4);
+}
+
+static void appendCodePoint(uint32_t codePoint, string& out)
+{
+    char encoded[3];
+    if (codePoint < 0x800)
+    {
+        encoded[0] = 0xC0 | (codePoint >> 6);
+        encoded[1] = 0x80 | (codePoint & 0x3F);
+        out.append(encoded, 2);
+    } else {
+        encoded[0] = 0xE0 | (codePoint >> 12);
+        encoded[1] = 0x80 | ((codePoint >> 6) & 0x3F);
+        encoded[2] = 0x80 | (codePoint & 0x3F);
+        out.append(encoded, 3);
+    }
+}
+
+// Returns the length of the well-formed UTF-8 sequence at src, or 0 if there is none.
+// Overlong forms, surrogates and code points past U+10FFFF are rejected.
+static size_t utf8SequenceLen(const byte* src, size_t len, uint32_t* codePoint)
+{
+    byte lead = src[0];
+    size_t seqLen;
+    uint32_t value;
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        seqLen = 2;
+        value = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        seqLen = 3;
+        value = lead & 0x0F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        seqLen = 4;
+        value = lead & 0x07;
+    } else {
+        return 0;
+    }
+
+    if (seqLen > len)
+    { return 0; }
+
+    for (size_t byteIdx = 1; byteIdx < seqLen; byteIdx++)
+    {
+        if ((src[byteIdx] & 0xC0) != 0x80)
+        { return 0; }
+        value = (value << 6) | (src[byteIdx] & 0x3F);
+    }
+
+    if (seqLen == 3 && (value < 0x800 || (value >= 0xD800 && value <= 0xDFFF)))
+    { return 0; }
+    if (seqLen == 4 && (value < 0x10000 || value > 0x10FFFF))
+    { return 0; }
+
+    *codePoint = value;
+    return seqLen;
+}
+
+size_t decodeText(const byte* src, size_t len, TextEncoding encoding, bool escape, bool stopAtNul, string& out)
+{
+    if (stopAtNul)
+    {
+        const byte* nul = (const byte*)memchr(src, 0, len);
+        if (nul != NULL)
+        { len = nul - src; }
+    }
+
+    out.reserve(out.size() + len);
+
+    size_t srcIdx = 0;
+    while (srcIdx < len)
+    {
+        size_t runLen = asciiRun(src + srcIdx, len - srcIdx, escape);
+        out.append((const char*)src + srcIdx, runLen);
+        srcIdx += runLen;
+        if (srcIdx == len)
+        { break; }
+
+        byte value = src[srcIdx];
+
+        if (value < 0x80)
+        {
+            // Only reached for control characters, and only when escaping
+            appendEscaped(value, out);
+            srcIdx++;
+            continue;
+        }
+
+        if (encoding == TEXT_CP437)
+        {
+            appendCodePoint(CP437_HIGH[value - 0x80], out);
+            srcIdx++;
+            continue;
+        }
+
+        uint32_t codePoint;
+        size_t seqLen = encoding == TEXT_UTF8 ? utf8SequenceLen(src + srcIdx, len - srcIdx, &codePoint) : 0;
+        if (seqLen == 0 || (escape && codePoint < 0xA0))
+        {
+            // Not text in this encoding, or a C1 control character
+            size_t badLen = seqLen > 0 ? seqLen : 1;
+            for (size_t badIdx = 0; badIdx < badLen; badIdx++)
+            {
+                if (escape)
+                { appendEscaped(src[srcIdx + badIdx], out); }
+                else
+                { out += src[srcIdx + badIdx]; }
+            }
+            srcIdx += badLen;
+            continue;
+        }
+
+        out.append((const char*)src + srcIdx, seqLen);
+        srcIdx += seqLen;
+    }
+
+    return len;
+}
@@ -0,0 +1,29 @@
+#ifndef BINVIEW_TEXT_DECODE
+#define BINVIEW_TEXT_DECODE
+
+#include <stddef.h>
+
+#include <string>
+
+#include "byteIterator.h"
+
+using namespace std;
+
+enum TextEncoding
+{
+    TEXT_ASCII,
+    TEXT_UTF8,
+    TEXT_CP437      // IBM PC code page 437, the zip default when flag bit 11 is clear
+};
+
+/*
+ * Appends src, decoded from encoding, to out as UTF-8. Runs of ASCII are found with SSE2/AVX2 and copied as is.
+ *
+ * With escape set, bytes that cannot be shown (control characters, invalid UTF-8, non-ASCII bytes in ASCII text)
+ * are written as "\xNN". Without it they are kept as they are.
+ *
+ * With stopAtNul set, decoding ends at the first NUL. Returns the number of bytes of src decoded.
+ */
+size_t decodeText(const byte* src, size_t len, TextEncoding encoding, bool escape, bool stopAtNul, string& out);
+
+#endif
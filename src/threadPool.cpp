@@ -0,0 +1,123 @@
+#include "threadPool.h"
+
+ThreadPool::ThreadPool(int threadCnt) : pendingCnt(0), queuedCnt(0), nextWorker(0), stopping(false)
+{
+    if (threadCnt <= 0)
+    { threadCnt = defaultThreadCnt(); }
+
+    for (int workerIdx = 0; workerIdx < threadCnt; workerIdx++)
+    {
+        workers.push_back(new Worker());
+    }
+
+    for (int workerIdx = 0; workerIdx < threadCnt; workerIdx++)
+    {
+        threads.push_back(thread(&ThreadPool::run, this, workerIdx));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        unique_lock<mutex> guard(idleLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (vector<thread>::iterator iter = threads.begin(); iter < threads.end(); iter++)
+    {
+        iter->join();
+    }
+
+    for (vector<Worker*>::iterator iter = workers.begin(); iter < workers.end(); iter++)
+    {
+        delete *iter;
+    }
+}
+
+int ThreadPool::defaultThreadCnt()
+{
+    unsigned int coreCnt = thread::hardware_concurrency();
+    return coreCnt ? coreCnt : 1;
+}
+
+int ThreadPool::getThreadCnt()
+{
+    return threads.size();
+}
+
+void ThreadPool::submit(function<void()> task)
+{
+    Worker* worker = workers[nextWorker++ % workers.size()];
+
+    pendingCnt++;
+    {
+        unique_lock<mutex> guard(worker->lock);
+        worker->tasks.push_back(task);
+    }
+
+    {
+        // Taking idleLock orders the increment against a worker deciding to sleep
+        unique_lock<mutex> guard(idleLock);
+        queuedCnt++;
+    }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    unique_lock<mutex> guard(idleLock);
+    while (pendingCnt > 0)
+    {
+        allDone.wait(guard);
+    }
+}
+
+// Takes the next task from the worker's own queue, or failing that, steals one from another worker
+bool ThreadPool::takeTask(int workerIdx, function<void()>& task)
+{
+    int workerCnt = workers.size();
+    for (int offset = 0; offset < workerCnt; offset++)
+    {
+        Worker* worker = workers[(workerIdx + offset) % workerCnt];
+
+        unique_lock<mutex> guard(worker->lock);
+        if (! worker->tasks.empty())
+        {
+            task = worker->tasks.front();
+            worker->tasks.pop_front();
+            queuedCnt--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::run(int workerIdx)
+{
+    function<void()> task;
+
+    while (true)
+    {
+        if (takeTask(workerIdx, task))
+        {
+            task();
+            task = NULL;
+
+            if (--pendingCnt == 0)
+            {
+                unique_lock<mutex> guard(idleLock);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        unique_lock<mutex> guard(idleLock);
+        if (stopping)
+        { return; }
+
+        if (queuedCnt == 0)
+        { workAvailable.wait(guard); }
+    }
+}
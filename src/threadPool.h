@@ -0,0 +1,63 @@
+#ifndef BINVIEW_THREAD_POOL
+#define BINVIEW_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* A fixed-size pool of worker threads, each with its own task queue.
+ *
+ * Submitted tasks are dealt round-robin onto the workers' queues. A worker
+ * whose queue runs dry steals from the other workers, so one slow task never
+ * leaves the remaining cores idle.
+ *
+ * Queues are kept in submission order, and both owners and thieves take from
+ * the front. Callers that submit their most expensive tasks first (e.g. the
+ * largest archive entries) therefore get them started first, which keeps the
+ * tail of a batch short.
+ */
+class ThreadPool
+{
+public:
+    ThreadPool(int threadCnt = 0);  // 0 means one thread per core
+    ~ThreadPool();
+
+    void submit(function<void()> task);
+
+    // Blocks until every submitted task has finished
+    void wait();
+
+    int getThreadCnt();
+
+    static int defaultThreadCnt();
+
+private:
+    struct Worker
+    {
+        mutex lock;
+        deque<function<void()> > tasks;
+    };
+
+    vector<Worker*> workers;
+    vector<thread> threads;
+
+    atomic<long> pendingCnt;    // Submitted but not yet finished
+    atomic<long> queuedCnt;     // Submitted but not yet started
+    atomic<unsigned int> nextWorker;
+    bool stopping;
+
+    mutex idleLock;
+    condition_variable workAvailable;
+    condition_variable allDone;
+
+    bool takeTask(int workerIdx, function<void()>& task);
+    void run(int workerIdx);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "zipEntry.h"
+#include "formatCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+
+#include <zlib.h>
+
+static const long CHUNK_SZ = 256 * 1024;
+
+uint64_t readNodeUInt(Node* node)
+{
+    Value value = decodeNode(node);
+    if (value.type != Value::TYPE_BYTES)
+    { return value.asUInt(); }
+
+    // Fields shown as hex (e.g. the CRC) are still little-endian integers
+    return readNodeRawUInt(node);
+}
+
+uint64_t readNodeRawUInt(Node* node)
+{
+    IByteIterator* itr = getDataNode(node)->accessor->iterator();
+    uint64_t raw = IntInterpretation::readAs64Bits(*itr, IntInterpretation::OPT_LITTLE_ENDIAN);
+    delete itr;
+    return raw;
+}
+
+string readNodeText(Node* node)
+{
+    return decodeNode(node).text;
+}
+
+bool ZipEntry::canDecompress() const
+{
+    return compressionMethod == METHOD_STORED || compressionMethod == METHOD_DEFLATED;
+}
+
+vector<Node*> findCentralDirectoryHeaders(Node* root)
+{
+    vector<Node*> headers;
+
+    for (Node* child = root->firstChild; child != NULL; child = child->nextSibling)
+    {
+        if (strcmp(child->description, "Central Directory") != 0)
+        { continue; }
+
+        for (Node* header = child->firstChild; header != NULL; header = header->nextSibling)
+        {
+            if (strcmp(header->description, "Central Directory File Header") == 0)
+            { headers.push_back(header); }
+        }
+    }
+
+    return headers;
+}
+
+vector<Node*> findLocalHeaders(Node* root)
+{
+    vector<Node*> headers;
+
+    // parse() places each "Local File Header" directly under the root, followed by its "File Data"
+    for (Node* child = root->firstChild; child != NULL; child = child->nextSibling)
+    {
+        if (strcmp(child->description, "Local File Header") == 0)
+        { headers.push_back(child); }
+    }
+
+    return headers;
+}
+
+vector<ZipEntry> findZipEntries(Node* root)
+{
+    map<long, Node*> localHeadersByOffset;
+    vector<Node*> localHeaders = findLocalHeaders(root);
+    for (vector<Node*>::iterator iter = localHeaders.begin(); iter < localHeaders.end(); iter++)
+    {
+        localHeadersByOffset[absoluteOffset(*iter)] = *iter;
+    }
+
+    vector<ZipEntry> entries;
+
+    vector<Node*> centralHeaders = findCentralDirectoryHeaders(root);
+    for (vector<Node*>::iterator iter = centralHeaders.begin(); iter < centralHeaders.end(); iter++)
+    {
+        Node* header = *iter;
+
+        ZipEntry entry;
+        entry.centralHeader = header;
+        entry.localHeader = NULL;
+        entry.fileData = NULL;
+        entry.name = readNodeText(findChild(header, "File name"));
+        entry.compressionMethod = readNodeUInt(findChild(header, "Compression method"));
+        entry.flags = readNodeUInt(findChild(header, "Flags"));
+        entry.crc32 = readNodeUInt(findChild(header, "CRC-32 checksum"));
+        entry.compressedSize = readNodeUInt(findChild(header, "Compressed size"));
+        entry.uncompressedSize = readNodeUInt(findChild(header, "Uncompressed size"));
+        entry.dataOffset = -1;
+
+        long localHeaderOffset = readNodeUInt(findChild(header, "Offset of local header"));
+        map<long, Node*>::iterator found = localHeadersByOffset.find(localHeaderOffset);
+        if (found != localHeadersByOffset.end())
+        {
+            entry.localHeader = found->second;
+
+            Node* fileData = entry.localHeader->nextSibling;
+            if (fileData != NULL && strcmp(fileData->description, "File Data") == 0)
+            { entry.fileData = fileData; }
+
+            entry.compressionMethod = readNodeUInt(findChild(entry.localHeader, "Compression method"));
+
+            // The local header's name and extra field need not be as long as the central directory's
+            entry.dataOffset = localHeaderOffset + 0x1E
+                + readNodeUInt(findChild(entry.localHeader, "File name length"))
+                + readNodeUInt(findChild(entry.localHeader, "Extra field length"));
+        }
+
+        entries.push_back(entry);
+    }
+
+    return entries;
+}
+
+static bool readStored(int fd, long offset, uint64_t len, function<bool(const byte*, long)>& sink)
+{
+    byte* buffer = (byte*)malloc(CHUNK_SZ);
+
+    uint64_t remaining = len;
+    bool ok = true;
+    while (ok && remaining > 0)
+    {
+        ssize_t readCnt = pread(fd, buffer, remaining < CHUNK_SZ ? remaining : CHUNK_SZ, offset);
+        if (readCnt <= 0)
+        {
+            ok = false;
+            break;
+        }
+
+        ok = sink(buffer, readCnt);
+        offset += readCnt;
+        remaining -= readCnt;
+    }
+
+    free(buffer);
+    return ok;
+}
+
+static bool readDeflated(int fd, long offset, uint64_t len, function<bool(const byte*, long)>& sink)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)  // Zip entries are raw deflate streams without a zlib header
+    { return false; }
+
+    byte* inBuffer = (byte*)malloc(CHUNK_SZ);
+    byte* outBuffer = (byte*)malloc(CHUNK_SZ);
+
+    uint64_t remaining = len;
+    int status = Z_OK;
+    bool ok = true;
+    while (ok && status != Z_STREAM_END && remaining > 0)
+    {
+        ssize_t readCnt = pread(fd, inBuffer, remaining < CHUNK_SZ ? remaining : CHUNK_SZ, offset);
+        if (readCnt <= 0)
+        {
+            ok = false;
+            break;
+        }
+        offset += readCnt;
+        remaining -= readCnt;
+
+        stream.next_in = inBuffer;
+        stream.avail_in = readCnt;
+        do
+        {
+            stream.next_out = outBuffer;
+            stream.avail_out = CHUNK_SZ;
+
+            // Z_BUF_ERROR is not fatal: the last call filled the output just as this chunk ran out
+            status = inflate(&stream, Z_NO_FLUSH);
+            if (status == Z_BUF_ERROR && stream.avail_in == 0)
+            {
+                status = Z_OK;
+                break;
+            }
+            if (status != Z_OK && status != Z_STREAM_END)
+            {
+                ok = false;
+                break;
+            }
+
+            ok = sink(outBuffer, CHUNK_SZ - stream.avail_out);
+        } while (ok && status != Z_STREAM_END && stream.avail_out == 0);
+    }
+
+    inflateEnd(&stream);
+    free(inBuffer);
+    free(outBuffer);
+
+    return ok && status == Z_STREAM_END;
+}
+
+bool readEntryData(int fd, const ZipEntry& entry, function<bool(const byte*, long)> sink)
+{
+    if (entry.localHeader == NULL)
+    { return false; }
+
+    switch (entry.compressionMethod)
+    {
+        case ZipEntry::METHOD_STORED:
+            return readStored(fd, entry.dataOffset, entry.compressedSize, sink);
+
+        case ZipEntry::METHOD_DEFLATED:
+            return readDeflated(fd, entry.dataOffset, entry.compressedSize, sink);
+    }
+
+    return false;
+}
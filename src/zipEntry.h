@@ -0,0 +1,70 @@
+#ifndef BINVIEW_ZIP_ENTRY
+#define BINVIEW_ZIP_ENTRY
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <inttypes.h>
+
+#include "hierarchy.h"
+
+using namespace std;
+
+// Zip-specific view of one archive member, gathered from the generic Node tree built by parse()
+class ZipEntry
+{
+public:
+    Node* centralHeader;
+    Node* localHeader;      // NULL if there is none at the offset the central directory gives
+    Node* fileData;         // NULL along with localHeader
+
+    // From the central directory, which has the sizes and CRC even when the local header leaves them to a data
+    // descriptor. The compression method is the local header's, as it describes the data following it.
+    string name;
+    uint16_t compressionMethod;
+    uint16_t flags;
+    uint32_t crc32;
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
+
+    long dataOffset;    // Relative to the start of the file. -1 without a local header.
+
+    enum COMPRESSION_METHOD {
+        METHOD_STORED = 0,
+        METHOD_DEFLATED = 8
+    };
+
+    enum FLAGS {
+        FLAG_DATA_DESCRIPTOR = 0x0008  // CRC and sizes in the local header are zero; the real values follow the data
+    };
+
+    bool canDecompress() const;
+};
+
+// Returns one entry per central directory file header, in central directory order
+vector<ZipEntry> findZipEntries(Node* root);
+
+// Returns every "Local File Header" node, in file order
+vector<Node*> findLocalHeaders(Node* root);
+
+// Returns every "Central Directory File Header" node, in file order
+vector<Node*> findCentralDirectoryHeaders(Node* root);
+
+/*
+ * Streams the entry's uncompressed bytes to sink in chunks. Reads through pread() on fd, so entries of
+ * the same file may be read from several threads at once.
+ * Returns false if the entry has no local header, the method is unsupported, the data is truncated or corrupt, or
+ * sink returns false.
+ */
+bool readEntryData(int fd, const ZipEntry& entry, function<bool(const byte*, long)> sink);
+
+// Reads the node's bytes as a little-endian unsigned integer
+uint64_t readNodeUInt(Node* node);
+
+// Same, without decoding the node first: dates, times and flags come out as their raw bits. Skips the format cache.
+uint64_t readNodeRawUInt(Node* node);
+
+// Reads the node's bytes as text
+string readNodeText(Node* node);
+
+#endif
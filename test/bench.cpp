@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <string>
+
+#include "../src/hierarchy.h"
+#include "../src/parser.h"
+#include "../src/extract.h"
+#include "../src/audit.h"
+#include "../src/threadPool.h"
+#include "../src/interpretation.h"
+#include "../src/hexEncode.h"
+#include "../src/textDecode.h"
+
+using namespace std;
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Extracts the archive once single-threaded and once on every core, reporting throughput of each
+int benchExtract(const char *path, int threadCnt)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        perror("Unable to read file.");
+        return 1;
+    }
+
+    Node *root = parse(fp);
+
+    int runThreadCnts[] = {1, threadCnt > 0 ? threadCnt : ThreadPool::defaultThreadCnt()};
+    for (int runIdx = 0; runIdx < 2; runIdx++)
+    {
+        char outDir[] = "/tmp/binview-bench-XXXXXX";
+        if (mkdtemp(outDir) == NULL)
+        {
+            perror("Unable to create output directory.");
+            return 1;
+        }
+
+        ExtractStats stats;
+        double start = now();
+        extractArchive(fp, root, outDir, runThreadCnts[runIdx], &stats);
+        double elapsed = now() - start;
+
+        printf("extract  threads=%-3d entries=%-8ld bytes=%-12" PRIu64 " %8.3f s  %8.1f MB/s\n",
+            runThreadCnts[runIdx], stats.entryCnt, stats.bytesWritten, elapsed, stats.bytesWritten / elapsed / 1e6);
+
+        string cleanup = string("rm -rf ") + outDir;
+        system(cleanup.c_str());
+    }
+
+    deleteNode(root);
+    fclose(fp);
+    return 0;
+}
+
+// Audits the archive once single-threaded and once on every core, reporting throughput of each
+int benchAudit(const char *path, int threadCnt)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        perror("Unable to read file.");
+        return 1;
+    }
+
+    int runThreadCnts[] = {1, threadCnt > 0 ? threadCnt : ThreadPool::defaultThreadCnt()};
+    for (int runIdx = 0; runIdx < 2; runIdx++)
+    {
+        // Fresh tree per run so annotations from the first run do not accumulate
+        Node *root = parse(fp);
+
+        AuditStats stats;
+        double start = now();
+        auditArchive(fp, root, runThreadCnts[runIdx], &stats);
+        double elapsed = now() - start;
+
+        printf("audit    threads=%-3d entries=%-8ld bytes=%-12" PRIu64 " %8.3f s  %8.1f MB/s\n",
+            runThreadCnts[runIdx], stats.entryCnt, stats.bytesChecked, elapsed, stats.bytesChecked / elapsed / 1e6);
+
+        deleteNode(root);
+        fseek(fp, 0, SEEK_SET);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+// Decodes and formats fields of each width from memory, reporting the cost per field
+int benchInt()
+{
+    const long FIELD_CNT = 1000000;
+    byte fields[16 * 64 + 32];     // 64 starting offsets, with room for the widest field
+    for (unsigned int byteIdx = 0; byteIdx < sizeof(fields); byteIdx++)
+    { fields[byteIdx] = byteIdx * 37 + 11; }
+
+    int widths[] = {1, 2, 4, 8, 16, 32};
+    for (int widthIdx = 0; widthIdx < 6; widthIdx++)
+    {
+        int width = widths[widthIdx];
+        for (int bigEndian = 0; bigEndian < 2; bigEndian++)
+        {
+            IntInterpretation interp(IntInterpretation::OPT_INCL_HEX | (bigEndian ? IntInterpretation::OPT_BIG_ENDIAN : 0));
+
+            uint64_t checksum = 0;
+            double start = now();
+            for (long fieldIdx = 0; fieldIdx < FIELD_CNT; fieldIdx++)
+            {
+                MemoryIterator itr(fields + (fieldIdx % 64) * 16, width);
+                checksum += IntInterpretation::readAs64Bits(itr, bigEndian ? IntInterpretation::OPT_BIG_ENDIAN : 0);
+            }
+            double decodeElapsed = now() - start;
+
+            long formatCnt = FIELD_CNT / 10;
+            start = now();
+            for (long fieldIdx = 0; fieldIdx < formatCnt; fieldIdx++)
+            {
+                MemoryIterator itr(fields + (fieldIdx % 64) * 16, width);
+                checksum += interp.format(itr, LOCALE_EN_US, Interpretation::UNBOUNDED).size();
+            }
+            double formatElapsed = now() - start;
+
+            printf("int      width=%-3d %s  decode %7.1f ns/field  format %7.1f ns/field  (%" PRIx64 ")\n",
+                width, bigEndian ? "BE" : "LE", decodeElapsed / FIELD_CNT * 1e9, formatElapsed / formatCnt * 1e9, checksum);
+        }
+    }
+
+    return 0;
+}
+
+// Hex-encodes a large buffer directly and through HexInterpretation, reporting output throughput
+int benchHex()
+{
+    const long BUFFER_SZ = 64 * 1024 * 1024;
+    byte* buffer = (byte*)malloc(BUFFER_SZ);
+    char* hex = (char*)malloc(BUFFER_SZ * 2);
+    for (long byteIdx = 0; byteIdx < BUFFER_SZ; byteIdx++)
+    { buffer[byteIdx] = byteIdx * 37 + 11; }
+
+    hexEncode(buffer, BUFFER_SZ, hex);     // Fault in the output pages first
+
+    double start = now();
+    hexEncode(buffer, BUFFER_SZ, hex);
+    double elapsed = now() - start;
+    printf("hex      hexEncode          %8.3f s  %8.1f MB/s of output\n", elapsed, BUFFER_SZ * 2 / elapsed / 1e6);
+
+    MemoryIterator itr(buffer, BUFFER_SZ);
+    start = now();
+    string out = Interpretation::hex->format(itr, LOCALE_EN_US, Interpretation::UNBOUNDED);
+    elapsed = now() - start;
+    printf("hex      HexInterpretation  %8.3f s  %8.1f MB/s of output\n", elapsed, out.size() / elapsed / 1e6);
+
+    free(buffer);
+    free(hex);
+    return 0;
+}
+
+// Decodes a million 48-byte names in each encoding, first all ASCII and then with an accented letter in each
+int benchText()
+{
+    const long NAME_CNT = 1000000;
+    const long NAME_LEN = 48;
+    byte* names = (byte*)malloc(NAME_CNT * NAME_LEN);
+    for (long byteIdx = 0; byteIdx < NAME_CNT * NAME_LEN; byteIdx++)
+    { names[byteIdx] = 'a' + byteIdx % 26; }
+
+    const char* encodingNames[] = {"ascii", "utf8", "cp437"};
+    TextEncoding encodings[] = {TEXT_ASCII, TEXT_UTF8, TEXT_CP437};
+    for (int accented = 0; accented < 2; accented++)
+    {
+        if (accented)
+        {
+            for (long nameIdx = 0; nameIdx < NAME_CNT; nameIdx++)
+            {
+                names[nameIdx * NAME_LEN + 40] = 0xC3;
+                names[nameIdx * NAME_LEN + 41] = 0xA9;
+            }
+        }
+
+        for (int encodingIdx = 0; encodingIdx < 3; encodingIdx++)
+        {
+            string out;
+            size_t outLen = 0;
+            double start = now();
+            for (long nameIdx = 0; nameIdx < NAME_CNT; nameIdx++)
+            {
+                out.clear();
+                decodeText(names + nameIdx * NAME_LEN, NAME_LEN, encodings[encodingIdx], true, false, out);
+                outLen += out.size();
+            }
+            double elapsed = now() - start;
+
+            printf("text     %-6s %-8s names=%-8ld %8.3f s  %8.1f MB/s  (%zu)\n", encodingNames[encodingIdx],
+                accented ? "accented" : "plain", NAME_CNT, elapsed, NAME_CNT * NAME_LEN / elapsed / 1e6, outLen);
+        }
+    }
+
+    free(names);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "extract") == 0)
+    { return benchExtract(argv[2], argc >= 4 ? atoi(argv[3]) : 0); }
+
+    if (argc >= 3 && strcmp(argv[1], "audit") == 0)
+    { return benchAudit(argv[2], argc >= 4 ? atoi(argv[3]) : 0); }
+
+    if (argc >= 2 && strcmp(argv[1], "int") == 0)
+    { return benchInt(); }
+
+    if (argc >= 2 && strcmp(argv[1], "hex") == 0)
+    { return benchHex(); }
+
+    if (argc >= 2 && strcmp(argv[1], "text") == 0)
+    { return benchText(); }
+
+    fprintf(stderr, "Usage: %s extract|audit <file.zip> [threads]\n", argv[0]);
+    fprintf(stderr, "       %s int|hex|text\n", argv[0]);
+    return 2;
+}
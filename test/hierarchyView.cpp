@@ -0,0 +1,233 @@
+#include "hierarchyView.h"
+
+#include <algorithm>
+
+HierarchyView::HierarchyView(const Node *root) : path(1, root), pathIdx(1, 0), top(0)
+{
+    update();
+}
+
+const vector<const Node*>& HierarchyView::childrenOf(const Node *node)
+{
+    unordered_map<const Node*, vector<const Node*> >::iterator found = children.find(node);
+    if (found != children.end())
+    { return found->second; }
+
+    vector<const Node*>& nodeChildren = children[node];
+    for (const Node *child = node->firstChild; child != NULL; child = child->nextSibling)
+    {
+        nodeChildren.push_back(child);
+    }
+    return nodeChildren;
+}
+
+int HierarchyView::childIndent(const Node *node, int indent)
+{
+    // Grouped children sit under their range's row
+    long childCnt = 0;
+    for (const Node *child = node->firstChild; child != NULL && childCnt <= GROUP_SIZE; child = child->nextSibling)
+    { childCnt++; }
+
+    return indent + ((childCnt > GROUP_SIZE) ? 2 : 1);
+}
+
+void HierarchyView::refresh()
+{
+    // Children are only ever appended, so each list is extended from where it ends
+    for (unordered_map<const Node*, vector<const Node*> >::iterator iter = children.begin(); iter != children.end(); iter++)
+    {
+        vector<const Node*>& nodeChildren = iter->second;
+        const Node *child = nodeChildren.empty() ? iter->first->firstChild : nodeChildren.back()->nextSibling;
+        for ( ; child != NULL; child = child->nextSibling)
+        {
+            nodeChildren.push_back(child);
+        }
+    }
+
+    update();
+}
+
+// Recomputes the row counts along the path, from the selection up
+void HierarchyView::update()
+{
+    int lastDepth = path.size() - 1;
+    pathRows.assign(path.size(), 1);
+    selectedRow = 0;
+
+    for (int depth = lastDepth - 1; depth >= 0; depth--)
+    {
+        long childCnt = childrenOf(path[depth]).size();
+        long childIdx = pathIdx[depth + 1];
+
+        // Rows before the path's child, then the path's child and below, then the rest
+        long before;
+        long after;
+        if (childCnt <= GROUP_SIZE)
+        {
+            before = childIdx;
+            after = childCnt - childIdx - 1;
+        } else {
+            long groupCnt = (childCnt + GROUP_SIZE - 1) / GROUP_SIZE;
+            long groupIdx = childIdx / GROUP_SIZE;
+            long groupStart = groupIdx * GROUP_SIZE;
+            long groupEnd = (groupStart + GROUP_SIZE < childCnt) ? groupStart + GROUP_SIZE : childCnt;
+
+            before = groupIdx + 1 + (childIdx - groupStart);
+            after = (groupEnd - childIdx - 1) + (groupCnt - groupIdx - 1);
+        }
+
+        pathRows[depth] = 1 + before + pathRows[depth + 1] + after;
+        selectedRow += 1 + before;
+    }
+}
+
+HierarchyView::Row HierarchyView::getRow(long rowIdx)
+{
+    int lastDepth = path.size() - 1;
+    int indent = 0;
+
+    for (int depth = 0; ; depth++)
+    {
+        if (rowIdx == 0 || depth == lastDepth)
+        {
+            Row row = {path[depth], NULL, 0, 0, indent, depth < lastDepth};
+            return row;
+        }
+        rowIdx--;
+
+        const vector<const Node*>& nodeChildren = childrenOf(path[depth]);
+        long childCnt = nodeChildren.size();
+        long childIdx = pathIdx[depth + 1];
+
+        if (childCnt <= GROUP_SIZE)
+        {
+            if (rowIdx < childIdx)
+            {
+                Row row = {nodeChildren[rowIdx], NULL, 0, 0, indent + 1, false};
+                return row;
+            }
+            rowIdx -= childIdx;
+
+            if (rowIdx < pathRows[depth + 1])
+            {
+                indent++;
+                continue;
+            }
+            rowIdx -= pathRows[depth + 1];
+
+            Row row = {nodeChildren[childIdx + 1 + rowIdx], NULL, 0, 0, indent + 1, false};
+            return row;
+        }
+
+        long groupIdx = childIdx / GROUP_SIZE;
+        long groupStart = groupIdx * GROUP_SIZE;
+        long groupEnd = (groupStart + GROUP_SIZE < childCnt) ? groupStart + GROUP_SIZE : childCnt;
+
+        // Collapsed ranges before the expanded one
+        if (rowIdx <= groupIdx)
+        {
+            long start = rowIdx * GROUP_SIZE;
+            Row row = {NULL, path[depth], start, (rowIdx == groupIdx) ? groupEnd : start + GROUP_SIZE, indent + 1, rowIdx == groupIdx};
+            return row;
+        }
+        rowIdx -= groupIdx + 1;
+
+        if (rowIdx < childIdx - groupStart)
+        {
+            Row row = {nodeChildren[groupStart + rowIdx], NULL, 0, 0, indent + 2, false};
+            return row;
+        }
+        rowIdx -= childIdx - groupStart;
+
+        if (rowIdx < pathRows[depth + 1])
+        {
+            indent += 2;
+            continue;
+        }
+        rowIdx -= pathRows[depth + 1];
+
+        if (rowIdx < groupEnd - childIdx - 1)
+        {
+            Row row = {nodeChildren[childIdx + 1 + rowIdx], NULL, 0, 0, indent + 2, false};
+            return row;
+        }
+        rowIdx -= groupEnd - childIdx - 1;
+
+        // Collapsed ranges after it
+        long start = (groupIdx + 1 + rowIdx) * GROUP_SIZE;
+        Row row = {NULL, path[depth], start, (start + GROUP_SIZE < childCnt) ? start + GROUP_SIZE : childCnt, indent + 1, false};
+        return row;
+    }
+}
+
+long HierarchyView::scroll(long visibleRows)
+{
+    if (selectedRow < top)
+    { top = selectedRow; }
+    if (selectedRow >= top + visibleRows)
+    { top = selectedRow - visibleRows + 1; }
+
+    return top;
+}
+
+bool HierarchyView::moveUp()
+{
+    if (getSelected()->prevSibling == NULL)
+    { return false; }
+
+    path.back() = getSelected()->prevSibling;
+    pathIdx.back()--;
+    update();
+    return true;
+}
+
+bool HierarchyView::moveDown()
+{
+    if (getSelected()->nextSibling == NULL)
+    { return false; }
+
+    path.back() = getSelected()->nextSibling;
+    pathIdx.back()++;
+    update();
+    return true;
+}
+
+bool HierarchyView::moveIn()
+{
+    if (getSelected()->firstChild == NULL)
+    { return false; }
+
+    path.push_back(getSelected()->firstChild);
+    pathIdx.push_back(0);
+    update();
+    return true;
+}
+
+bool HierarchyView::moveOut()
+{
+    if (path.size() == 1)
+    { return false; }
+
+    path.pop_back();
+    pathIdx.pop_back();
+    update();
+    return true;
+}
+
+void HierarchyView::select(const Node *node)
+{
+    vector<const Node*> ancestors;
+    for ( ; node != NULL; node = node->parent)
+    {
+        ancestors.push_back(node);
+    }
+
+    path.assign(ancestors.rbegin(), ancestors.rend());
+    pathIdx.assign(1, 0);
+    for (size_t depth = 1; depth < path.size(); depth++)
+    {
+        const vector<const Node*>& siblings = childrenOf(path[depth - 1]);
+        pathIdx.push_back(find(siblings.begin(), siblings.end(), path[depth]) - siblings.begin());
+    }
+    update();
+}
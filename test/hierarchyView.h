@@ -0,0 +1,73 @@
+#ifndef BINVIEW_HIERARCHY_VIEW
+#define BINVIEW_HIERARCHY_VIEW
+
+#include <unordered_map>
+#include <vector>
+
+#include "../src/hierarchy.h"
+
+using namespace std;
+
+/* The rows of the hierarchy pane, computed on demand so only the rows on screen are ever visited.
+ *
+ * The expanded nodes are exactly the ancestors of the selected node. Each of them shows its children as one row
+ * apiece, except the one on the path down to the selection, which shows its own children below it. Children past
+ * GROUP_SIZE are grouped into ranges of GROUP_SIZE ("entries 0-999"); only the range holding the path is expanded.
+ *
+ * Row counts are kept for each node on the path, so finding the node at any row takes one step per level.
+ */
+class HierarchyView
+{
+public:
+    static const long GROUP_SIZE = 1000;
+
+    struct Row
+    {
+        const Node *node;   // NULL for a range of children
+        const Node *parent; // For ranges, the node whose children they are
+        long groupStart;    // Ranges: children [groupStart, groupEnd)
+        long groupEnd;
+        int indent;
+        bool expanded;
+    };
+
+    HierarchyView(const Node *root);
+
+    const Node *getSelected() { return path.back(); }
+
+    // Move the selection, returning false when there is nowhere to move
+    bool moveUp();
+    bool moveDown();
+    bool moveIn();
+    bool moveOut();
+
+    // Selects node, which must be in the tree, expanding its ancestors
+    void select(const Node *node);
+
+    long getRowCnt() { return pathRows[0]; }
+    long getSelectedRow() { return selectedRow; }
+    Row getRow(long rowIdx);
+
+    // Indent of node's children when it is expanded, given its own
+    static int childIndent(const Node *node, int indent);
+
+    // Call after children were appended to nodes of the tree
+    void refresh();
+
+    // Returns the first row to show in a pane of visibleRows rows, scrolled as little as keeps the selection visible
+    long scroll(long visibleRows);
+
+private:
+    vector<const Node*> path;   // From the root down to the selected node
+    vector<long> pathIdx;       // pathIdx[depth] is the index of path[depth] among its siblings
+    vector<long> pathRows;      // pathRows[depth] is the number of rows shown for path[depth] and what it expands to
+    long selectedRow;
+    long top;
+
+    unordered_map<const Node*, vector<const Node*> > children;  // Built the first time a node is expanded
+
+    const vector<const Node*>& childrenOf(const Node *node);
+    void update();
+};
+
+#endif
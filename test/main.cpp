@@ -1,18 +1,56 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include <algorithm>
+
+#include <poll.h>
+#include <signal.h>
 #include <termios.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include "color.h"
+#include "screen.h"
+#include "hierarchyView.h"
+#include "viewerWorker.h"
 
 #include "../src/hierarchy.h"
 #include "../src/parser.h"
 #include "../src/interpretation.h"
+#include "../src/formatCache.h"
+#include "../src/hexEncode.h"
+#include "../src/extract.h"
+#include "../src/audit.h"
+#include "../src/dump.h"
+#include "../src/catalog.h"
+#include "../src/entryTable.h"
+#include "../src/nodeIndex.h"
+
+// Bytes [start, end) of the file are drawn in color
+struct ColorSpan
+{
+    long start;
+    long end;
+    int color;
+};
+
+Screen screen;  // The viewer's frame; drawing goes here rather than to stdout
+ViewerWorker *worker = NULL;    // Parses and formats for the viewer
+struct termios originalTerminal;    // Put back however the viewer exits
+
+void restoreTerminal();
+void restoreTerminalOnSignal(int signum);
+
+void draw(FILE *fp, HierarchyView& view, const vector<ColorSpan>& spans, long viewOffset, long fileSize);
 
-void draw(FILE *fp, const Node *root, const Node *selected);
+int hexPaneRows();
+long clampView(long viewOffset, long fileSize);
+long viewFor(const Node *node, long fileSize);
+long promptOffset();
 
 int nodeHasChild(const Node *node);
-int expandNode(const Node *root, const Node *selected);
 
 unsigned char toPrintableChar(unsigned char ch);
 int read16(FILE *fp, unsigned char* buffer);
@@ -23,37 +61,248 @@ unsigned long readNodeValueLong(FILE *fp, const Node *node);
 
 void printHeader();
 void print16(unsigned char* buffer, int bufferSz, long offset, int colors[]);
-void printNodeValue(FILE *fp, const Node *node);
+void printNodeValue(FILE *fp, const Node *node, long maxLen);
 
-void setColor(int color);
+int terminalWidth();
+int terminalHeight();
 
-void findColors(const Node *rootNode, const Node *selected, long offset, long length, int *result);
-void findColorsRecur(const Node *rootNode, long rootOffset, const Node *selected, long offset, long length, int *result);
+vector<ColorSpan> buildColorSpans(const Node *selected);
+void addNodeSpans(const Node *node, vector<ColorSpan>& out);
+void findColors(const vector<ColorSpan>& spans, size_t *cursor, long offset, long length, int *result);
 
-void printHierarchy(FILE *fp, const Node *rootNode, const Node *selected);
-void printHierarchyRecur(FILE *fp, const Node *node, const Node *selected, int depth);
+void printHierarchy(FILE *fp, HierarchyView& view, long rowCnt);
+long hierarchyValueLen(const Node *node, int indent);
+void prefetchNeighbors(HierarchyView& view);
+void printHierarchyRow(FILE *fp, const HierarchyView::Row& row, const Node *selected);
 
 int isLittleEndian();
 
+int extractMain(int argc, char **argv);
+int auditMain(int argc, char **argv);
+int dumpMain(int argc, char **argv);
+int indexMain(int argc, char **argv);
+int queryMain(int argc, char **argv);
+int tableMain(int argc, char **argv);
+bool readPathList(const char *listPath, vector<string>& paths);
+void printAnnotations(const Node *node, string path);
+
 int main(int argc, char **argv)
 {
+    if (argc >= 2 && strcmp(argv[1], "-x") == 0)
+    { return extractMain(argc, argv); }
+
+    if (argc >= 2 && strcmp(argv[1], "-c") == 0)
+    { return auditMain(argc, argv); }
+
+    if (argc >= 2 && strcmp(argv[1], "-d") == 0)
+    { return dumpMain(argc, argv); }
+
+    if (argc >= 2 && strcmp(argv[1], "-i") == 0)
+    { return indexMain(argc, argv); }
+
+    if (argc >= 2 && strcmp(argv[1], "-q") == 0)
+    { return queryMain(argc, argv); }
+
+    if (argc >= 2 && strcmp(argv[1], "-t") == 0)
+    { return tableMain(argc, argv); }
+
+    if (argc < 2)
+    {
+        perror("Missing an argument.");
+        return 2;
+    }
+
+    // The hex pane, the parser and formatting each read through their own handle, as they run on different threads
+    FILE *fp = fopen(argv[1], "r");
+    FILE *parseFp = fopen(argv[1], "r");
+    FILE *dataFp = fopen(argv[1], "r");
+
+    if (fp == NULL || parseFp == NULL || dataFp == NULL)
+    {
+        perror("Unable to read file.");
+        return 1;
+    }
+
     struct termios info;
     tcgetattr(0, &info);          /* get current terminal attirbutes; 0 is the file descriptor for stdin */
-    info.c_lflag &= ~ICANON;      /* disable canonical mode */
+    originalTerminal = info;
+    atexit(restoreTerminal);
+    signal(SIGINT, restoreTerminalOnSignal);
+    signal(SIGTERM, restoreTerminalOnSignal);
+    info.c_lflag &= ~(ICANON | ECHO); /* disable canonical mode and echo; only screen.flush() writes to the terminal */
     info.c_cc[VMIN] = 1;          /* wait until at least one keystroke available */
     info.c_cc[VTIME] = 0;         /* no timeout */
     tcsetattr(0, TCSANOW, &info); /* set immediately */
 
-    if (argc < 2)
+    setvbuf(stdin, NULL, _IONBF, 0);    // So poll() sees every key that getchar() has not read yet
+
+    worker = new ViewerWorker(parseFp, dataFp);
+
+    fseek(fp, 0, SEEK_END);
+    long fileSize = ftell(fp);
+
+    HierarchyView view(worker->getRoot());
+    vector<ColorSpan> spans;
+    long viewOffset = 0;    // Offset of the first row of the hex pane; a multiple of 16
+    NodeIndex *index = NULL;    // For going to an offset. Built on first use.
+    bool indexComplete = false; // Whether index was built from the whole tree
     {
-        perror("Missing an argument.");
-        return 2;
+        unique_lock<mutex> guard(worker->getTreeLock());
+        spans = buildColorSpans(view.getSelected());
     }
 
-    FILE *fp;
+    while(1)
+    {
+        {
+            unique_lock<mutex> guard(worker->getTreeLock());
+            draw(fp, view, spans, viewOffset, fileSize);
+        }
 
-    fp = fopen(argv[1], "r");
+        // Wait for a key, or for the worker to have parsed or formatted more
+        struct pollfd fds[2] = {{0, POLLIN, 0}, {worker->getWakeFd(), POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0)
+        { continue; }
+
+        if (fds[1].revents & POLLIN)
+        {
+            worker->clearWake();
+
+            unique_lock<mutex> guard(worker->getTreeLock());
+            view.refresh();
+            spans = buildColorSpans(view.getSelected());
+        }
+
+        if (!(fds[0].revents & (POLLIN | POLLHUP)))
+        { continue; }
+
+        // Read the whole key before taking the tree lock
+        int nextChar = getchar();
+        int escapeChar = 0;
+        if (nextChar == '\033')
+        {
+            getchar();  // '['
+            escapeChar = getchar();
+            if (escapeChar == '5' || escapeChar == '6')
+            { getchar(); }  // '~'
+        }
+
+        if (nextChar == 'q' || nextChar == EOF)
+        {
+            Node *root = worker->getRoot();
+            delete worker;
+            delete index;
+            deleteNode(root);
+
+            fclose(fp);
+            fclose(parseFp);
+            fclose(dataFp);
+            return 0;
+        }
+
+        if (nextChar == 'g')    // Go to offset, selecting the deepest node there
+        {
+            long offset = promptOffset();
+            if (offset < 0)
+            { continue; }
+            viewOffset = clampView(offset, fileSize);
+
+            // Until the parse is done, each lookup indexes the tree as it is so far
+            unique_lock<mutex> guard(worker->getTreeLock());
+            if (index == NULL || !indexComplete)
+            {
+                delete index;
+                indexComplete = worker->isParsed();
+                index = new NodeIndex(worker->getRoot());
+            }
+
+            Node *found = index->findAt(offset);
+            if (found != NULL)
+            {
+                view.select(found);
+                spans = buildColorSpans(found);
+                prefetchNeighbors(view);
+            }
+            continue;
+        }
+
+        unique_lock<mutex> guard(worker->getTreeLock());
+        bool moved = false;
+
+        switch (escapeChar)
+        {
+            case 'A':   // Up
+                moved = view.moveUp();
+                break;
+
+            case 'B':   // Down
+                moved = view.moveDown();
+                break;
+
+            case 'C':   // Right
+                moved = view.moveIn();
+                break;
+
+            case 'D':   // Left
+                moved = view.moveOut();
+                break;
+
+            case '5':   // Page up
+                viewOffset = clampView(viewOffset - hexPaneRows() * 16L, fileSize);
+                break;
+
+            case '6':   // Page down
+                viewOffset = clampView(viewOffset + hexPaneRows() * 16L, fileSize);
+                break;
+        }
+
+        if (moved)
+        {
+            spans = buildColorSpans(view.getSelected());
+            viewOffset = viewFor(view.getSelected(), fileSize);
+            prefetchNeighbors(view);
+        }
+    }
+}
+
+void restoreTerminal()
+{
+    tcsetattr(0, TCSANOW, &originalTerminal);
+}
+
+// Restores the terminal, then dies of the signal as if it were not caught
+void restoreTerminalOnSignal(int signum)
+{
+    tcsetattr(0, TCSANOW, &originalTerminal);
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
+// Usage: a.out -x <output dir> [-j <threads>] <file>
+int extractMain(int argc, char **argv)
+{
+    const char *outDir = NULL;
+    const char *path = NULL;
+    int threadCnt = 0;
 
+    for (int argIdx = 1; argIdx < argc; argIdx++)
+    {
+        if (strcmp(argv[argIdx], "-x") == 0 && argIdx + 1 < argc)
+        {
+            outDir = argv[++argIdx];
+        } else if (strcmp(argv[argIdx], "-j") == 0 && argIdx + 1 < argc) {
+            threadCnt = atoi(argv[++argIdx]);
+        } else {
+            path = argv[argIdx];
+        }
+    }
+
+    if (outDir == NULL || path == NULL)
+    {
+        fprintf(stderr, "Usage: %s -x <output dir> [-j <threads>] <file>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *fp = fopen(path, "r");
     if (fp == NULL)
     {
         perror("Unable to read file.");
@@ -62,121 +311,433 @@ int main(int argc, char **argv)
 
     Node *root = parse(fp);
 
-    Node *selected = root;
+    ExtractStats stats;
+    long failedCnt = extractArchive(fp, root, outDir, threadCnt, &stats);
+    printf("Extracted %ld of %ld entries (%" PRIu64 " bytes)\n", stats.entryCnt - failedCnt, stats.entryCnt, stats.bytesWritten);
 
-    while(1)
-    {
-        draw(fp, root, selected);
+    deleteNode(root);
+    fclose(fp);
 
-        char nextChar = getchar();
-        switch (nextChar)
+    return failedCnt == 0 ? 0 : 1;
+}
+
+// Usage: a.out -c [-j <threads>] <file>
+int auditMain(int argc, char **argv)
+{
+    const char *path = NULL;
+    int threadCnt = 0;
+
+    for (int argIdx = 2; argIdx < argc; argIdx++)
+    {
+        if (strcmp(argv[argIdx], "-j") == 0 && argIdx + 1 < argc)
         {
-            case 'q':
-                fclose(fp);
-                deleteNode(root);
-                return 0;
-
-            case '\033':
-                getchar();
-                nextChar = getchar();
-
-                switch (nextChar)
-                {
-                    case 'A':   // Up
-                        if (selected->prevSibling)
-                        { selected = selected->prevSibling; }
-                        break;
-
-                    case 'B':   // Down
-                        if (selected->nextSibling)
-                        { selected = selected->nextSibling; }
-                        break;
-                        
-                    case 'C':   // Right
-                        if (selected->firstChild)
-                        { selected = selected->firstChild; }
-                        break;
-                        
-                    case 'D':   // Left
-                        if (selected->parent)
-                        { selected = selected->parent; }
-                        break;
-                        
-                }
+            threadCnt = atoi(argv[++argIdx]);
+        } else {
+            path = argv[argIdx];
         }
     }
+
+    if (path == NULL)
+    {
+        fprintf(stderr, "Usage: %s -c [-j <threads>] <file>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        perror("Unable to read file.");
+        return 1;
+    }
+
+    Node *root = parse(fp);
+
+    AuditStats stats;
+    long problemCnt = auditArchive(fp, root, threadCnt, &stats);
+    printAnnotations(root, "");
+    printf("Checked %ld of %ld entries (%" PRIu64 " bytes), %ld problems\n", stats.verifiedCnt, stats.entryCnt, stats.bytesChecked, problemCnt);
+
+    deleteNode(root);
+    fclose(fp);
+
+    return problemCnt == 0 ? 0 : 1;
 }
 
-void draw(FILE *fp, const Node *root, const Node *selected)
+// Usage: a.out -d [-j <threads>] [-b] [-u] [-m <max value length>] [-l <list file>] [<file>...]
+// -b writes binary records instead of JSON Lines, -u writes each file as soon as it is done. The list file holds one
+// path per line; "-" reads it from stdin.
+int dumpMain(int argc, char **argv)
 {
-    printf("\033[2J\n");
+    vector<string> paths;
+    DumpOptions options;
+
+    for (int argIdx = 2; argIdx < argc; argIdx++)
+    {
+        if (strcmp(argv[argIdx], "-j") == 0 && argIdx + 1 < argc)
+        {
+            options.threadCnt = atoi(argv[++argIdx]);
+        } else if (strcmp(argv[argIdx], "-m") == 0 && argIdx + 1 < argc) {
+            options.maxValueLen = atol(argv[++argIdx]);
+        } else if (strcmp(argv[argIdx], "-b") == 0) {
+            options.format = DUMP_BINARY;
+        } else if (strcmp(argv[argIdx], "-u") == 0) {
+            options.ordered = false;
+        } else if (strcmp(argv[argIdx], "-l") == 0 && argIdx + 1 < argc) {
+            if (!readPathList(argv[++argIdx], paths))
+            {
+                perror("Unable to read file list.");
+                return 1;
+            }
+        } else {
+            paths.push_back(argv[argIdx]);
+        }
+    }
+
+    if (paths.empty())
+    {
+        fprintf(stderr, "Usage: %s -d [-j <threads>] [-b] [-u] [-m <max value length>] [-l <list file>] [<file>...]\n", argv[0]);
+        return 2;
+    }
 
-    fseek(fp, 0, SEEK_SET);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
-    const int BUFFER_SIZE = 16;
-    unsigned char buffer[BUFFER_SIZE];
-    int bytesRead = BUFFER_SIZE;
-    long offset = 0;
-    int colors[BUFFER_SIZE];
+    DumpStats stats;
+    long failedCnt = dumpFiles(paths, stdout, options, &stats);
 
-    printHeader();
-    while ((bytesRead = read16(fp, buffer)) == BUFFER_SIZE)
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // stdout holds the dump, so the summary goes to stderr
+    fprintf(stderr, "Dumped %ld of %ld files (%ld nodes, %" PRIu64 " bytes) in %.2f s, %.0f files/s\n",
+        stats.fileCnt - failedCnt, stats.fileCnt, stats.nodeCnt, stats.bytesWritten, seconds, stats.fileCnt / seconds);
+
+    return failedCnt == 0 ? 0 : 1;
+}
+
+// Usage: a.out -i <catalog> [-j <threads>] [-l <list file>] [<file>...]
+// Indexes the files into the catalog, which afterwards covers exactly these files. Only new and changed files are
+// parsed.
+int indexMain(int argc, char **argv)
+{
+    const char *catalogPath = (argc >= 3) ? argv[2] : NULL;
+    vector<string> paths;
+    int threadCnt = 0;
+
+    for (int argIdx = 3; argIdx < argc; argIdx++)
     {
-        findColors(root, selected, offset, BUFFER_SIZE, colors);
+        if (strcmp(argv[argIdx], "-j") == 0 && argIdx + 1 < argc)
+        {
+            threadCnt = atoi(argv[++argIdx]);
+        } else if (strcmp(argv[argIdx], "-l") == 0 && argIdx + 1 < argc) {
+            if (!readPathList(argv[++argIdx], paths))
+            {
+                perror("Unable to read file list.");
+                return 1;
+            }
+        } else {
+            paths.push_back(argv[argIdx]);
+        }
+    }
 
-        print16(buffer, bytesRead, offset, colors);
-        offset += BUFFER_SIZE;
+    if (catalogPath == NULL)
+    {
+        fprintf(stderr, "Usage: %s -i <catalog> [-j <threads>] [-l <list file>] [<file>...]\n", argv[0]);
+        return 2;
     }
-    findColors(root, selected, offset, BUFFER_SIZE, colors);
-    print16(buffer, bytesRead, offset, colors);
 
-    printf("\n");
+    CatalogStats stats;
+    if (!updateCatalog(catalogPath, paths, threadCnt, &stats))
+    {
+        perror("Unable to write catalog.");
+        return 1;
+    }
 
-    printHierarchy(fp, root, selected);
-    setColor(NONE);
+    printf("Indexed %ld archives (%ld unchanged, %ld unreadable), %ld entries\n", stats.archiveCnt, stats.reusedCnt, stats.failedCnt, stats.entryCnt);
+    return stats.failedCnt == 0 ? 0 : 1;
 }
 
-int nodeHasChild(const Node *node)
+// Usage: a.out -q <catalog> [-n <name glob>] [-m <method>] [-c <min compressed size>] [-C <max compressed size>]
+//                           [-u <min uncompressed size>] [-U <max uncompressed size>]
+// Prints "archive<TAB>name<TAB>compressed size<TAB>uncompressed size<TAB>method<TAB>CRC-32" for every matching entry
+int queryMain(int argc, char **argv)
 {
-    return (node->firstChild != NULL) ? 1 : 0;
+    const char *catalogPath = (argc >= 3) ? argv[2] : NULL;
+    CatalogQuery query;
+
+    for (int argIdx = 3; argIdx + 1 < argc; argIdx += 2)
+    {
+        const char *value = argv[argIdx + 1];
+        if (strcmp(argv[argIdx], "-n") == 0)
+        { query.nameGlob = value; }
+        else if (strcmp(argv[argIdx], "-m") == 0)
+        { query.compressionMethod = atoi(value); }
+        else if (strcmp(argv[argIdx], "-c") == 0)
+        { query.minCompressedSize = strtoull(value, NULL, 0); }
+        else if (strcmp(argv[argIdx], "-C") == 0)
+        { query.maxCompressedSize = strtoull(value, NULL, 0); }
+        else if (strcmp(argv[argIdx], "-u") == 0)
+        { query.minUncompressedSize = strtoull(value, NULL, 0); }
+        else if (strcmp(argv[argIdx], "-U") == 0)
+        { query.maxUncompressedSize = strtoull(value, NULL, 0); }
+        else
+        { catalogPath = NULL; }
+    }
+
+    if (catalogPath == NULL || argc % 2 == 0)
+    {
+        fprintf(stderr, "Usage: %s -q <catalog> [-n <name glob>] [-m <method>] [-c <min compressed size>] [-C <max compressed size>] [-u <min uncompressed size>] [-U <max uncompressed size>]\n", argv[0]);
+        return 2;
+    }
+
+    Catalog catalog(catalogPath);
+    if (!catalog.isOpen())
+    {
+        fprintf(stderr, "%s: not a catalog\n", catalogPath);
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    vector<long> entries = catalog.query(query);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (vector<long>::iterator iter = entries.begin(); iter < entries.end(); iter++)
+    {
+        CatalogEntry entry = catalog.getEntry(*iter);
+        printf("%s\t%s\t%" PRIu64 "\t%" PRIu64 "\t%u\t%08" PRIx32 "\n", catalog.getArchivePath(catalog.getEntryArchive(*iter)), entry.name.c_str(),
+            entry.compressedSize, entry.uncompressedSize, entry.compressionMethod, entry.crc32);
+    }
+
+    double millis = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    fprintf(stderr, "%zu of %ld entries matched in %.1f ms\n", entries.size(), catalog.getEntryCnt(), millis);
+    return 0;
 }
 
-// Expand root if it is an ancestor of selected
-int expandNode(const Node *root, const Node *selected)
+// Usage: a.out -t <file> [-s <column>] [-r] [-n <name glob> | -e <name regex>] [-j <threads>]
+// Lists the archive's entries sorted by column: name, compressed, uncompressed, method, crc, modified or offset (file
+// order if none). -r reverses it. Prints "name<TAB>compressed size<TAB>uncompressed size<TAB>method<TAB>CRC-32<TAB>
+// header offset", the last being where the entry's central directory file header starts.
+int tableMain(int argc, char **argv)
 {
-    // TODO: Redesign; super inefficient right now
-    Node *child = root->firstChild;
-    while(child)
+    static const char *COLUMN_NAMES[] = {"", "name", "compressed", "uncompressed", "method", "crc", "modified", "offset"};
+
+    const char *path = (argc >= 3) ? argv[2] : NULL;
+    EntryTable::Column column = EntryTable::COL_ROW;
+    bool descending = false;
+    const char *glob = NULL;
+    const char *regex = NULL;
+    int threadCnt = 0;
+
+    for (int argIdx = 3; argIdx < argc && path != NULL; argIdx++)
     {
-        if (child == selected)
-        {
-            return 1;
-        }
-        if (expandNode(child, selected))
+        const char *value = (argIdx + 1 < argc) ? argv[argIdx + 1] : NULL;
+        if (strcmp(argv[argIdx], "-r") == 0)
         {
-            return 1;
+            descending = true;
+        } else if (strcmp(argv[argIdx], "-s") == 0 && value != NULL) {
+            const char **found = find(COLUMN_NAMES + 1, COLUMN_NAMES + 8, string(value));
+            column = (EntryTable::Column)(found - COLUMN_NAMES);
+            path = (found < COLUMN_NAMES + 8) ? path : NULL;
+            argIdx++;
+        } else if (strcmp(argv[argIdx], "-n") == 0 && value != NULL) {
+            glob = argv[++argIdx];
+        } else if (strcmp(argv[argIdx], "-e") == 0 && value != NULL) {
+            regex = argv[++argIdx];
+        } else if (strcmp(argv[argIdx], "-j") == 0 && value != NULL) {
+            threadCnt = atoi(argv[++argIdx]);
+        } else {
+            path = NULL;
         }
+    }
+
+    if (path == NULL || (glob != NULL && regex != NULL))
+    {
+        fprintf(stderr, "Usage: %s -t <file> [-s name|compressed|uncompressed|method|crc|modified|offset] [-r] [-n <name glob> | -e <name regex>] [-j <threads>]\n", argv[0]);
+        return 2;
+    }
 
-        child = child->nextSibling;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        perror("Unable to open file.");
+        return 1;
+    }
+
+    EntryTable table(threadCnt);
+    Node *root = parse(fp, &table);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Filtered first, so fewer rows are sorted
+    vector<uint32_t> rows;
+    if (glob != NULL)
+    {
+        rows = table.filterGlob(glob);
+    } else if (regex != NULL && !table.filterRegex(regex, rows)) {
+        fprintf(stderr, "%s: invalid regular expression\n", regex);
+        deleteNode(root);
+        fclose(fp);
+        return 2;
     }
+    rows = table.sort(column, descending, (glob != NULL || regex != NULL) ? &rows : NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
+    for (vector<uint32_t>::iterator iter = rows.begin(); iter < rows.end(); iter++)
+    {
+        printf("%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%08" PRIx64 "\t%ld\n", table.getName(*iter),
+            table.get(EntryTable::COL_COMPRESSED_SIZE, *iter), table.get(EntryTable::COL_UNCOMPRESSED_SIZE, *iter),
+            table.get(EntryTable::COL_COMPRESSION_METHOD, *iter), table.get(EntryTable::COL_CRC32, *iter),
+            absoluteOffset(table.getHeader(*iter)));
+    }
+
+    double millis = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    fprintf(stderr, "%zu of %ld entries listed in %.1f ms\n", rows.size(), table.size(), millis);
+
+    deleteNode(root);
+    fclose(fp);
     return 0;
 }
 
-void setColor(int color)
+// Appends the paths listed one per line in the file at listPath, or on stdin for "-"
+bool readPathList(const char *listPath, vector<string>& paths)
 {
-    if (color == NONE)
+    FILE *listFp = (strcmp(listPath, "-") == 0) ? stdin : fopen(listPath, "r");
+    if (listFp == NULL)
+    { return false; }
+
+    char *line = NULL;
+    size_t lineSz = 0;
+    ssize_t lineLen;
+    while ((lineLen = getline(&line, &lineSz, listFp)) != -1)
     {
-        printf("\e[0m");
-        return;
+        if (lineLen > 0 && line[lineLen - 1] == '\n')
+        { lineLen--; }
+        if (lineLen > 0)
+        { paths.push_back(string(line, lineLen)); }
     }
+    free(line);
+
+    if (listFp != stdin)
+    { fclose(listFp); }
+    return true;
+}
+
+// Prints "path/to/node: annotation" for every annotated node
+void printAnnotations(const Node *node, string path)
+{
+    path += node->description;
 
-    if (color & 0x8)
+    if (node->annotation != NULL)
     {
-        printf("\e[1;3%dm", color & 0x7);
-    } else {
-        printf("\e[0;3%dm", color);
+        printf("%s: %s\n", path.c_str(), node->annotation);
     }
+
+    for (const Node *child = node->firstChild; child != NULL; child = child->nextSibling)
+    {
+        printAnnotations(child, path + "/");
+    }
+}
+
+// Only the rows that fit the terminal are read, formatted and printed, so redrawing costs the same for any file size
+// and tree size. The frame is composed in screen, then only what changed since the last frame is written.
+void draw(FILE *fp, HierarchyView& view, const vector<ColorSpan>& spans, long viewOffset, long fileSize)
+{
+    worker->beginFrame();
+
+    screen.begin(terminalWidth(), terminalHeight());
+    screen.print(worker->isParsed() ? "\n" : "Parsing...\n");
+
+    const int BUFFER_SIZE = 16;
+    int rowCnt = hexPaneRows();
+    long length = rowCnt * BUFFER_SIZE;
+    if (length > fileSize - viewOffset)
+    { length = fileSize - viewOffset; }
+
+    unsigned char *buffer = (unsigned char *)malloc(rowCnt * BUFFER_SIZE);
+    int *colors = (int *)malloc(sizeof(int) * rowCnt * BUFFER_SIZE);
+
+    long bytesRead = readAt(fp, viewOffset, length, buffer);
+
+    printHeader();
+    size_t spanCursor = 0;
+    for (long rowIdx = 0; rowIdx * BUFFER_SIZE < bytesRead || rowIdx == 0; rowIdx++)
+    {
+        long rowStart = rowIdx * BUFFER_SIZE;
+        long rowBytes = (bytesRead - rowStart < BUFFER_SIZE) ? bytesRead - rowStart : BUFFER_SIZE;
+        findColors(spans, &spanCursor, viewOffset + rowStart, rowBytes, &colors[rowStart]);
+        print16(&buffer[rowStart], rowBytes, viewOffset + rowStart, &colors[rowStart]);
+    }
+
+    free(buffer);
+    free(colors);
+
+    screen.print("\n");
+
+    printHierarchy(fp, view, screen.getHeight() - screen.getCursorRow());
+    screen.flush();
+}
+
+// Rows of the hex pane: half the terminal, leaving the rest for the hierarchy
+int hexPaneRows()
+{
+    const int MIN_ROWS = 4;
+    int rows = (terminalHeight() - 2) / 2;    // Less the header and the blank line after the pane
+    return rows > MIN_ROWS ? rows : MIN_ROWS;
+}
+
+// Aligns viewOffset to a row and keeps it within the file
+long clampView(long viewOffset, long fileSize)
+{
+    long lastRow = (fileSize > 0) ? (fileSize - 1) & ~15L : 0;
+    if (viewOffset > lastRow)
+    { viewOffset = lastRow; }
+    if (viewOffset < 0)
+    { viewOffset = 0; }
+
+    return viewOffset & ~15L;
+}
+
+// The view that starts at the row holding node's first byte
+long viewFor(const Node *node, long fileSize)
+{
+    return clampView(absoluteOffset(node), fileSize);
+}
+
+// Reads a hex offset typed by the user, up to Enter. Returns -1 if nothing valid was typed.
+long promptOffset()
+{
+    // Typed over the bottom line, so the next frame is drawn in full
+    printf("\e[%d;1H\e[0m\e[KGo to offset (hex): ", screen.getHeight());
+    fflush(stdout);
+    screen.invalidate();
+
+    char input[32];
+    int inputLen = 0;
+    for (int ch = getchar(); ch != '\n' && ch != EOF; ch = getchar())
+    {
+        if (inputLen < (int)sizeof(input) - 1)
+        {
+            input[inputLen++] = ch;
+            putchar(ch);    // Echo is off
+            fflush(stdout);
+        }
+    }
+    input[inputLen] = '\0';
+
+    char *end;
+    long offset = strtol(input, &end, 16);
+    if (inputLen == 0 || *end != '\0')
+    { return -1; }
+
+    return offset;
+}
+
+int nodeHasChild(const Node *node)
+{
+    return (node->firstChild != NULL) ? 1 : 0;
 }
 
 inline unsigned char toPrintableChar(unsigned char ch)
@@ -222,12 +783,23 @@ inline long readAt(FILE *fp, long offset, long length, unsigned char* buffer)
     return idx;
 }
 
+// Reads the node's segments, one after the other
 // !! Caller is responsible for freeing memory
 inline unsigned char *readNodeValue(FILE *fp, const Node *node)
 {
-    // TODO: Work on more than one segment
-    unsigned char *buffer = (unsigned char *)malloc(sizeof(char) * node->segments[0].length);
-    readAt(fp, node->segments[0].offset, node->segments[0].length, buffer);   // TODO: Handle error case (return value != node->segments[0].length)
+    long length = 0;
+    for (int segmentIdx = 0; segmentIdx < node->segmentCnt; segmentIdx++)
+    {
+        length += node->segments[segmentIdx].length;
+    }
+
+    unsigned char *buffer = (unsigned char *)malloc(sizeof(char) * length);
+    long bufferIdx = 0;
+    for (int segmentIdx = 0; segmentIdx < node->segmentCnt; segmentIdx++)
+    {
+        Segment segment = absoluteSegment(node, segmentIdx);
+        bufferIdx += readAt(fp, segment.offset, segment.length, &buffer[bufferIdx]);  // TODO: Handle error case (a segment cut short by the end of the file)
+    }
     return buffer;
 }
 
@@ -251,176 +823,280 @@ inline unsigned long readNodeValueLong(FILE *fp, const Node *node)
 
 void printHeader()
 {
-    setColor(NONE);
-    printf("          ");
+    screen.setColor(NONE);
+    screen.print("          ");
 
     for (int colIdx = 0; colIdx < 8; colIdx++)
     {
-        printf("%02X ", colIdx);
+        screen.print("%02X ", colIdx);
     }
 
-    printf(" ");
+    screen.print(" ");
 
     for (int colIdx = 8; colIdx < 16; colIdx++)
     {
-        printf("%02X ", colIdx);
+        screen.print("%02X ", colIdx);
     }
 
-    printf("\n");
+    screen.print("\n");
 }
 
 inline void print16(unsigned char* buffer, int bufferSz, long offset, int colors[])
 {
-    setColor(NONE);
-    printf("%08lX  ", offset);
+    char hex[32];
+    hexEncode(buffer, bufferSz, hex);
 
-    for (int counter = 0; counter < 8; counter++)
-    {
-        if (counter >= bufferSz)
-        {
-            printf("   ");
-        } else {
-            setColor(colors[counter]);
-            printf("%02X ", buffer[counter]);
-        }
-    }
+    screen.setColor(NONE);
+    screen.print("%08lX  ", offset);
 
-    printf(" ");
-
-    for (int counter = 8; counter < 16; counter++)
+    for (int counter = 0; counter < 16; counter++)
     {
+        if (counter == 8)
+        { screen.write(" ", 1); }
+
         if (counter >= bufferSz)
         {
-            printf("   ");
-        } else {
-            setColor(colors[counter]);
-            printf("%02X ", buffer[counter]);
+            screen.write("   ", 3);
+            continue;
         }
+
+        screen.setColor(colors[counter]);
+        screen.write(&hex[counter * 2], 2);
+        screen.write(" ", 1);
     }
 
-    printf("  ");
+    screen.write("  ", 2);
 
     for (int counter = 0; counter < 16 && counter < bufferSz; counter++)
     {
-        setColor(colors[counter]);
-        printf("%c", toPrintableChar(buffer[counter]));
+        char ch = toPrintableChar(buffer[counter]);
+        screen.setColor(colors[counter]);
+        screen.write(&ch, 1);
     }
 
-    printf("\n");
+    screen.write("\n", 1);
+}
+
+// maxLen caps the characters printed, and with them the bytes read from the node.
+// Values the worker has not formatted yet show as "...".
+void printNodeValue(FILE *fp, const Node *node, long maxLen)
+{
+    string value;
+    if (!worker->format((Node*)node, maxLen, value))
+    { value = "..."; }
+    screen.write(value.data(), value.size());
+}
+
+int terminalWidth()
+{
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0)
+    { return 80; }
+
+    return size.ws_col;
 }
 
-void printNodeValue(FILE *fp, const Node *node)
+int terminalHeight()
 {
-    unsigned char *nodeValue = readNodeValue(fp, node);
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_row == 0)
+    { return 24; }
 
-    //MemoryIterator valueItr = MemoryIterator(nodeValue, node->segments[0].length);
-    IByteIterator *valueItr = node->dataNode->accessor->iterator();
+    return size.ws_row;
+}
 
-    if (node->pInterpretation != NULL)
+// The selected node is drawn in white over its parent in light blue. Returns non-overlapping spans sorted by start;
+// only needs rebuilding when the selection changes.
+vector<ColorSpan> buildColorSpans(const Node *selected)
+{
+    vector<ColorSpan> parentSpans;
+    vector<ColorSpan> selectedSpans;
+    if (selected->parent != NULL)
+    { addNodeSpans(selected->parent, parentSpans); }
+    addNodeSpans(selected, selectedSpans);
+
+    vector<long> bounds;
+    for (vector<ColorSpan>::iterator iter = parentSpans.begin(); iter < parentSpans.end(); iter++)
+    {
+        bounds.push_back(iter->start);
+        bounds.push_back(iter->end);
+    }
+    for (vector<ColorSpan>::iterator iter = selectedSpans.begin(); iter < selectedSpans.end(); iter++)
     {
-        printf("%s", node->pInterpretation->format(*valueItr, LOCALE_EN_US).c_str());
+        bounds.push_back(iter->start);
+        bounds.push_back(iter->end);
+    }
+    sort(bounds.begin(), bounds.end());
+    bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+
+    // Between consecutive bounds the color is constant. Like the tree, a node is only drawn within its parent.
+    vector<ColorSpan> spans;
+    for (size_t boundIdx = 0; boundIdx + 1 < bounds.size(); boundIdx++)
+    {
+        long start = bounds[boundIdx];
+        bool inParent = false;
+        bool inSelected = false;
+        for (vector<ColorSpan>::iterator iter = parentSpans.begin(); iter < parentSpans.end(); iter++)
+        { inParent |= (iter->start <= start && start < iter->end); }
+        for (vector<ColorSpan>::iterator iter = selectedSpans.begin(); iter < selectedSpans.end(); iter++)
+        { inSelected |= (iter->start <= start && start < iter->end); }
+
+        int color = NONE;
+        if (inSelected && (inParent || selected->parent == NULL))
+        { color = WHITE; }
+        else if (inParent)
+        { color = LIGHT_BLUE; }
+
+        if (color == NONE)
+        { continue; }
+
+        if (!spans.empty() && spans.back().end == start && spans.back().color == color)
+        {
+            spans.back().end = bounds[boundIdx + 1];
+        } else {
+            ColorSpan span = {start, bounds[boundIdx + 1], color};
+            spans.push_back(span);
+        }
     }
-    free(valueItr);
 
-    free(nodeValue);
+    return spans;
 }
 
-// offset parameter is relative to start of data, which should be the start of rootNode
-void findColors(const Node *rootNode, const Node *selected, long offset, long length, int *result)
+// Appends the absolute ranges of node's segments
+void addNodeSpans(const Node *node, vector<ColorSpan>& out)
 {
-    for (long resultIdx = 0; resultIdx < length; resultIdx++)
+    for (int segmentIdx = 0; segmentIdx < node->segmentCnt; segmentIdx++)
     {
-        result[resultIdx] = NONE;
+        Segment segment = absoluteSegment(node, segmentIdx);
+        ColorSpan span = {segment.offset, segment.offset + segment.length, NONE};
+        out.push_back(span);
     }
-
-    findColorsRecur(rootNode, 0L, selected, offset, length, result);
 }
 
-// offset parameter is relative to start of data
-// segment offset is relative to the start of the parent node, which is called rootNode here
-// rootOffset parameter is the start of the rootNode relative to start of data
-void findColorsRecur(const Node *rootNode, long rootOffset, const Node *selected, long offset, long length, int *result)
+// Colors bytes [offset, offset + length). Rows are colored in order, so *cursor, the first span that may still
+// overlap, only moves forward; start it at 0.
+void findColors(const vector<ColorSpan>& spans, size_t *cursor, long offset, long length, int *result)
 {
     for (long resultIdx = 0; resultIdx < length; resultIdx++)
     {
-        if (rootNode == selected->parent)
-        {
-            result[resultIdx] = LIGHT_BLUE;
-        }
-        if (rootNode == selected)
-        {
-            result[resultIdx] = WHITE;
-        }
+        result[resultIdx] = NONE;
     }
 
-    Node *childNode = rootNode->firstChild;
-    while(childNode)
-    {
-        for (int segmentIdx = 0; segmentIdx < childNode->segmentCnt; segmentIdx++)
-        {
-            Segment segment = childNode->segments[segmentIdx];
+    while (*cursor < spans.size() && spans[*cursor].end <= offset)
+    { (*cursor)++; }
 
-            if (rootOffset + segment.offset < offset + length && rootOffset + segment.offset + segment.length > offset)
-            {
-                // TODO: Clean this up so it's actually understandable
-                long startIdx = (rootOffset + segment.offset < offset) ? 0 : rootOffset + segment.offset - offset;
-                long endIdx = (rootOffset + segment.offset + segment.length > offset + length) ? length : rootOffset + segment.offset + segment.length - offset;
+    for (size_t spanIdx = *cursor; spanIdx < spans.size() && spans[spanIdx].start < offset + length; spanIdx++)
+    {
+        long startIdx = (spans[spanIdx].start > offset) ? spans[spanIdx].start - offset : 0;
+        long endIdx = (spans[spanIdx].end < offset + length) ? spans[spanIdx].end - offset : length;
 
-                findColorsRecur(childNode, rootOffset + segment.offset, selected, startIdx + offset, endIdx - startIdx, &result[startIdx]);
-            }
+        for (long resultIdx = startIdx; resultIdx < endIdx; resultIdx++)
+        {
+            result[resultIdx] = spans[spanIdx].color;
         }
-
-        childNode = childNode->nextSibling;
     }
 }
 
-void printHierarchy(FILE *fp, const Node *rootNode, const Node *selected)
+// Prints the rows of the hierarchy that fit in rowCnt lines
+void printHierarchy(FILE *fp, HierarchyView& view, long rowCnt)
 {
-    printHierarchyRecur(fp, rootNode, selected, 0);
+    if (rowCnt < 1)
+    { rowCnt = 1; }
+
+    long top = view.scroll(rowCnt);
+    for (long rowIdx = top; rowIdx < view.getRowCnt() && rowIdx < top + rowCnt; rowIdx++)
+    {
+        printHierarchyRow(fp, view.getRow(rowIdx), view.getSelected());
+    }
 }
 
-void printHierarchyRecur(FILE *fp, const Node *node, const Node *selected, int depth)
+void printHierarchyRow(FILE *fp, const HierarchyView::Row& row, const Node *selected)
 {
-    for (int depthIdx = 0; depthIdx < depth; depthIdx++)
+    for (int indentIdx = 0; indentIdx < row.indent; indentIdx++)
     {
-        printf("  ");
+        screen.print("  ");
+    }
+
+    if (row.node == NULL)
+    {
+        screen.setColor(NONE);
+        screen.print("%s entries %ld-%ld\n", row.expanded ? "-" : "+", row.groupStart, row.groupEnd - 1);
+        return;
     }
 
+    const Node *node = row.node;
     if (node == selected->parent)
     {
-        setColor(LIGHT_BLUE);
+        screen.setColor(LIGHT_BLUE);
     } else if (node == selected)
     {
-        setColor(WHITE);
+        screen.setColor(WHITE);
     } else {
-        setColor(NONE);
+        screen.setColor(NONE);
     }
     if (nodeHasChild(node))
     {
-        if (expandNode(node, selected))
+        if (row.expanded)
         {
-            printf("- ");
+            screen.print("- ");
         } else {
-            printf("+ ");
+            screen.print("+ ");
         }
     } else {
-        printf("  ");
+        screen.print("  ");
     }
-    printf("%s", node->description);
-    printf(": ");
-    printNodeValue(fp, node);
-    printf("\n");
+    screen.print("%s", node->description);
+    screen.print(": ");
 
-    if (expandNode(node, selected))
+    printNodeValue(fp, node, hierarchyValueLen(node, row.indent));
+    if (node->annotation != NULL)
     {
-        Node *childNode = node->firstChild;
-        while(childNode)
-        {
-            printHierarchyRecur(fp, childNode, selected, depth + 1);
+        screen.setColor(LIGHT_RED);
+        screen.print("  [%s]", node->annotation);
+    }
+    screen.print("\n");
+}
 
-            childNode = childNode->nextSibling;
-        }
+// Keep each node on one line: whatever is left of the terminal width after the indent and description
+long hierarchyValueLen(const Node *node, int indent)
+{
+    const long MIN_VALUE_LEN = 24;
+    long valueLen = terminalWidth() - (indent * 2 + 2 + strlen(node->description) + 2);
+    return valueLen > MIN_VALUE_LEN ? valueLen : MIN_VALUE_LEN;
+}
+
+// Has the worker read ahead and format the rows the next move is likely to show: the selection's siblings, its
+// children (shown when moving right) and its parent's next sibling. Caller holds the tree lock.
+void prefetchNeighbors(HierarchyView& view)
+{
+    const Node *selected = view.getSelected();
+    int indent = view.getRow(view.getSelectedRow()).indent;
+    int childIndent = HierarchyView::childIndent(selected, indent);
+    long rowCnt = terminalHeight() - hexPaneRows() - 3;
+
+    vector<pair<Node*, long> > nodes;
+    if (selected->nextSibling != NULL)
+    { nodes.push_back(make_pair(selected->nextSibling, hierarchyValueLen(selected->nextSibling, indent))); }
+    if (selected->firstChild != NULL)
+    { nodes.push_back(make_pair(selected->firstChild, hierarchyValueLen(selected->firstChild, childIndent))); }
+    if (selected->prevSibling != NULL)
+    { nodes.push_back(make_pair(selected->prevSibling, hierarchyValueLen(selected->prevSibling, indent))); }
+
+    const Node *parent = selected->parent;
+    if (parent != NULL && parent->nextSibling != NULL)
+    {
+        int parentIndent = indent - HierarchyView::childIndent(parent, 0);
+        nodes.push_back(make_pair(parent->nextSibling, hierarchyValueLen(parent->nextSibling, parentIndent)));
     }
+
+    long childCnt = 1;
+    for (Node *child = (selected->firstChild != NULL) ? selected->firstChild->nextSibling : NULL; child != NULL && childCnt < rowCnt; child = child->nextSibling)
+    {
+        nodes.push_back(make_pair(child, hierarchyValueLen(child, childIndent)));
+        childCnt++;
+    }
+
+    worker->prefetch(nodes);
 }
 
 int isLittleEndian()
@@ -0,0 +1,184 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "screen.h"
+
+Screen::Screen() : width(0), height(0), shownValid(false), row(0), col(0), color(NONE) {}
+
+void Screen::begin(int width, int height)
+{
+    if (width != this->width || height != this->height)
+    {
+        this->width = width;
+        this->height = height;
+        shown.resize(width * height);
+        shownValid = false;
+    }
+
+    Cell blank = {{' '}, 1, NONE};
+    cells.assign(width * height, blank);
+
+    row = 0;
+    col = 0;
+    color = NONE;
+}
+
+void Screen::setColor(int color)
+{
+    this->color = color;
+}
+
+void Screen::write(const char* text, size_t len)
+{
+    for (size_t textIdx = 0; textIdx < len; textIdx++)
+    {
+        char ch = text[textIdx];
+        if (ch == '\n')
+        {
+            row++;
+            col = 0;
+            continue;
+        }
+
+        // UTF-8 continuation bytes belong to the character before
+        if ((ch & 0xC0) == 0x80 && col > 0)
+        {
+            if (row < height && col <= width)
+            {
+                Cell& cell = cells[row * width + col - 1];
+                if (cell.len < sizeof(cell.bytes))
+                { cell.bytes[cell.len++] = ch; }
+            }
+            continue;
+        }
+
+        if (row < height && col < width)
+        {
+            Cell& cell = cells[row * width + col];
+            cell.bytes[0] = ch;
+            cell.len = 1;
+            cell.color = color;
+        }
+        col++;
+    }
+}
+
+void Screen::print(const char* format, ...)
+{
+    char buffer[256];
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (len < (int)sizeof(buffer))
+    {
+        write(buffer, len);
+        return;
+    }
+
+    char* longBuffer = (char*)malloc(len + 1);
+    va_start(args, format);
+    vsnprintf(longBuffer, len + 1, format, args);
+    va_end(args);
+
+    write(longBuffer, len);
+    free(longBuffer);
+}
+
+void Screen::invalidate()
+{
+    shownValid = false;
+}
+
+void Screen::appendColor(string& out, int color)
+{
+    char escape[16];
+    if (color == NONE)
+    {
+        out += "\e[0m";
+    } else if (color & 0x8) {
+        out.append(escape, sprintf(escape, "\e[1;3%dm", color & 0x7));
+    } else {
+        out.append(escape, sprintf(escape, "\e[0;3%dm", color));
+    }
+}
+
+void Screen::appendCells(string& out, int row, int startCol, int endCol, int* curColor)
+{
+    char escape[32];
+    out.append(escape, sprintf(escape, "\e[%d;%dH", row + 1, startCol + 1));
+
+    for (int cellCol = startCol; cellCol < endCol; cellCol++)
+    {
+        const Cell& cell = cells[row * width + cellCol];
+        if (cell.color != *curColor)
+        {
+            *curColor = cell.color;
+            appendColor(out, cell.color);
+        }
+        out.append(cell.bytes, cell.len);
+    }
+}
+
+void Screen::flush()
+{
+    // Unchanged cells between two changed ones are rewritten when that is shorter than moving the cursor past them
+    const int MAX_GAP = 8;
+
+    string out;
+    int curColor = -2;  // Unknown, so the first cell sets it
+
+    // After clearing, the terminal holds a blank frame, which only differs from this one where something was drawn
+    if (!shownValid)
+    {
+        Cell blank = {{' '}, 1, NONE};
+        shown.assign(width * height, blank);
+        out += "\e[0m\e[2J";
+    }
+
+    for (int cellRow = 0; cellRow < height; cellRow++)
+    {
+        int runStart = -1;
+        int runEnd = -1;
+        for (int cellCol = 0; cellCol < width; cellCol++)
+        {
+            int cellIdx = cellRow * width + cellCol;
+            if (cells[cellIdx] == shown[cellIdx])
+            { continue; }
+
+            if (runStart != -1 && cellCol - runEnd > MAX_GAP)
+            {
+                appendCells(out, cellRow, runStart, runEnd, &curColor);
+                runStart = -1;
+            }
+            if (runStart == -1)
+            { runStart = cellCol; }
+            runEnd = cellCol + 1;
+        }
+
+        if (runStart != -1)
+        { appendCells(out, cellRow, runStart, runEnd, &curColor); }
+    }
+
+    // Leave the cursor below what was drawn
+    char escape[32];
+    out += "\e[0m";
+    out.append(escape, sprintf(escape, "\e[%d;1H", (row < height ? row : height - 1) + 1));
+
+    fflush(stdout);
+    size_t written = 0;
+    while (written < out.size())
+    {
+        ssize_t result = ::write(STDOUT_FILENO, out.data() + written, out.size() - written);
+        if (result <= 0)
+        { break; }
+        written += result;
+    }
+
+    shown = cells;
+    shownValid = true;
+}
@@ -0,0 +1,65 @@
+#ifndef BINVIEW_SCREEN
+#define BINVIEW_SCREEN
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "color.h"
+
+using namespace std;
+
+/* A frame of terminal cells, composed in memory and then written out in one go.
+ *
+ * Each frame is drawn from scratch with print() and setColor(), like printing to the terminal. flush() compares it
+ * with the frame shown before and writes only the cells that changed, with a color escape only where the color
+ * changes, in a single write(). Text past the right or bottom edge is dropped.
+ */
+class Screen
+{
+public:
+    Screen();
+
+    // Starts a new frame of the given size, blank and with the cursor at the top left
+    void begin(int width, int height);
+
+    void setColor(int color);
+    void write(const char* text, size_t len);
+    void print(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Writes the changes since the last frame to stdout
+    void flush();
+
+    // Call after writing to the terminal other than through flush(). The next flush repaints everything.
+    void invalidate();
+
+    int getHeight() { return height; }
+    int getCursorRow() { return row; }
+
+private:
+    struct Cell
+    {
+        char bytes[4];  // One character: an ASCII byte or a UTF-8 sequence
+        unsigned char len;
+        signed char color;
+
+        bool operator==(const Cell& other) const
+        { return len == other.len && color == other.color && memcmp(bytes, other.bytes, len) == 0; }
+        bool operator!=(const Cell& other) const { return !(*this == other); }
+    };
+
+    int width;
+    int height;
+    vector<Cell> cells;
+    vector<Cell> shown;     // What the terminal holds
+    bool shownValid;
+
+    int row;
+    int col;
+    int color;
+
+    static void appendColor(string& out, int color);
+    void appendCells(string& out, int row, int startCol, int endCol, int* curColor);
+};
+
+#endif
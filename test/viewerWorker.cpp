@@ -0,0 +1,172 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "viewerWorker.h"
+#include "../src/formatCache.h"
+
+ViewerWorker::ViewerWorker(FILE *parseFp, FILE *dataFp) : parser(parseFp, dataFp, &treeLock), parsed(false), prefetchesHinted(true), stopping(false)
+{
+    if (pipe(wakePipe) == 0)
+    {
+        fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);   // A full pipe already means a redraw is due
+    }
+
+    worker = thread(&ViewerWorker::run, this);
+}
+
+ViewerWorker::~ViewerWorker()
+{
+    {
+        unique_lock<mutex> guard(lock);
+        stopping = true;
+    }
+    requestAdded.notify_one();
+    worker.join();
+
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+}
+
+void ViewerWorker::wake()
+{
+    char ch = 0;
+    if (write(wakePipe[1], &ch, 1) < 0)
+    {}
+}
+
+void ViewerWorker::clearWake()
+{
+    char buffer[64];
+    while (read(wakePipe[0], buffer, sizeof(buffer)) > 0)
+    {}
+}
+
+void ViewerWorker::beginFrame()
+{
+    unique_lock<mutex> guard(lock);
+    requests.clear();
+}
+
+bool ViewerWorker::format(Node *node, long maxLen, string& out)
+{
+    if (node->pInterpretation == NULL)
+    {
+        out = "";
+        return true;
+    }
+
+    if (getFormatCache(getRoot())->lookup(node, LOCALE_EN_US, maxLen, out))
+    { return true; }
+
+    {
+        unique_lock<mutex> guard(lock);
+        Request request = {node, maxLen};
+        requests.push_back(request);
+    }
+    requestAdded.notify_one();
+    return false;
+}
+
+void ViewerWorker::prefetch(const vector<pair<Node*, long> >& nodes)
+{
+    {
+        unique_lock<mutex> guard(lock);
+        prefetches.clear();
+        for (vector<pair<Node*, long> >::const_iterator iter = nodes.begin(); iter < nodes.end(); iter++)
+        {
+            Request request = {iter->first, iter->second};
+            prefetches.push_back(request);
+        }
+        prefetchesHinted = false;
+    }
+    requestAdded.notify_one();
+}
+
+void ViewerWorker::run()
+{
+    // Parse in slices this long between looking for requests, and wake the viewer for new records at most this often
+    const chrono::milliseconds PARSE_SLICE(10);
+    const chrono::milliseconds WAKE_INTERVAL(50);
+    // Formatting reads little of a large node (see maxLen), so no more than this much of each is hinted
+    const long PREFETCH_BYTES = 64 * 1024;
+
+    chrono::steady_clock::time_point lastWake = chrono::steady_clock::now();
+
+    while (true)
+    {
+        Request request;
+        bool haveRequest = false;
+        bool moreRequests = false;
+        bool havePrefetch = false;
+        vector<Node*> toHint;
+        {
+            unique_lock<mutex> guard(lock);
+            while (!stopping && requests.empty() && prefetches.empty() && parsed)
+            { requestAdded.wait(guard); }
+
+            if (stopping)
+            { return; }
+
+            if (!requests.empty())
+            {
+                request = requests.front();
+                requests.pop_front();
+                haveRequest = true;
+                moreRequests = !requests.empty();
+            } else if (!prefetches.empty()) {
+                if (!prefetchesHinted)
+                {
+                    for (deque<Request>::iterator iter = prefetches.begin(); iter < prefetches.end(); iter++)
+                    { toHint.push_back(iter->node); }
+                    prefetchesHinted = true;
+                }
+
+                request = prefetches.front();
+                prefetches.pop_front();
+                havePrefetch = true;
+            }
+        }
+
+        if (haveRequest)
+        {
+            formatNode(request.node, LOCALE_EN_US, request.maxLen);
+            if (!moreRequests)
+            { wake(); }
+            continue;
+        }
+
+        // The bytes of all the nodes, and of the nodes their values are made from, are hinted up front. Later reads
+        // are then already on their way while the first node is formatted.
+        if (havePrefetch)
+        {
+            vector<Node*> dependencies;
+            for (vector<Node*>::iterator iter = toHint.begin(); iter < toHint.end(); iter++)
+            {
+                getDataNode(*iter)->accessor->prefetch(PREFETCH_BYTES);
+                if ((*iter)->pInterpretation != NULL)
+                { (*iter)->pInterpretation->getDependencies(dependencies); }
+            }
+            for (vector<Node*>::iterator iter = dependencies.begin(); iter < dependencies.end(); iter++)
+            { getDataNode(*iter)->accessor->prefetch(PREFETCH_BYTES); }
+
+            formatNode(request.node, LOCALE_EN_US, request.maxLen);
+            continue;
+        }
+
+        chrono::steady_clock::time_point sliceStart = chrono::steady_clock::now();
+        while (parser.step() && chrono::steady_clock::now() - sliceStart < PARSE_SLICE)
+        {}
+
+        if (parser.isDone())
+        { parsed = true; }
+
+        if (parsed || chrono::steady_clock::now() - lastWake >= WAKE_INTERVAL)
+        {
+            wake();
+            lastWake = chrono::steady_clock::now();
+        }
+    }
+}
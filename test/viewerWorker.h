@@ -0,0 +1,78 @@
+#ifndef BINVIEW_VIEWER_WORKER
+#define BINVIEW_VIEWER_WORKER
+
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/hierarchy.h"
+#include "../src/parser.h"
+
+using namespace std;
+
+/* Parses the file and formats node values on a background thread, so the viewer never waits on the file.
+ *
+ * The tree grows while the viewer shows it; hold getTreeLock() while reading it. Values that are not formatted yet
+ * are queued and formatted in the order asked for, ahead of further parsing. Starting a frame drops whatever the
+ * previous frame asked for and did not get, since the next frame asks again for what it still shows.
+ *
+ * When there is nothing else to do, the worker reads ahead and formats the nodes the viewer is likely to show next,
+ * as given to prefetch().
+ *
+ * Whenever the tree grows or a value is ready, a byte is written to getWakeFd(), so the viewer can poll() it
+ * alongside its input and redraw.
+ */
+class ViewerWorker
+{
+public:
+    // parseFp is read by the parser; dataFp backs the nodes' bytes. Neither is used by any other thread.
+    ViewerWorker(FILE *parseFp, FILE *dataFp);
+    ~ViewerWorker();
+
+    Node *getRoot() { return parser.getRoot(); }
+    mutex& getTreeLock() { return treeLock; }
+    bool isParsed() { return parsed; }
+
+    int getWakeFd() { return wakePipe[0]; }
+    void clearWake();
+
+    void beginFrame();
+
+    // Sets out and returns true if the node's value is ready. Otherwise queues it and returns false.
+    bool format(Node *node, long maxLen, string& out);
+
+    // Replaces the nodes to read ahead and format when idle, most likely first, each with the length it would be shown at
+    void prefetch(const vector<pair<Node*, long> >& nodes);
+
+private:
+    struct Request
+    {
+        Node *node;
+        long maxLen;
+    };
+
+    mutex treeLock;     // Before parser, which holds a pointer to it
+    IncrementalParser parser;
+    atomic<bool> parsed;
+
+    mutex lock;
+    condition_variable requestAdded;
+    deque<Request> requests;
+    deque<Request> prefetches;
+    bool prefetchesHinted;  // Whether the bytes of every node in prefetches were hinted
+    bool stopping;
+
+    int wakePipe[2];
+    thread worker;
+
+    void run();
+    void wake();
+};
+
+#endif